@@ -0,0 +1,766 @@
+#include "asm_generator.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <vector>
+
+namespace {
+    using namespace bytecode;
+
+    // Allocatable registers. The first five are callee-saved and survive
+    // calls; r10 and r11 are free between calls, and the argument registers
+    // hold values that are not live at a call at all. eax, ecx and edx are
+    // scratch registers of the instruction patterns.
+    const int CALLEE_SAVED = 5;
+    const int CALLER_SAVED = 7;
+    const int REGISTER_COUNT = 11;
+    const char *const REGISTERS_32[REGISTER_COUNT] = {"%ebx", "%r12d", "%r13d", "%r14d", "%r15d", "%r10d", "%r11d",
+                                                      "%esi", "%edi", "%r8d", "%r9d"};
+    const char *const REGISTERS_64[REGISTER_COUNT] = {"%rbx", "%r12", "%r13", "%r14", "%r15", "%r10", "%r11",
+                                                      "%rsi", "%rdi", "%r8", "%r9"};
+    const char *const ARGUMENT_REGISTERS[] = {"%edi", "%esi", "%edx", "%ecx", "%r8d", "%r9d"};
+    const int REGISTER_ARGUMENTS = 6;
+
+    const char *const DIVISION_BY_ZERO = ".Ldivision_by_zero";
+
+    // Condition codes of EQ..GE and of their negation
+    const char *conditionCode(Opcode op) {
+        static const char *const codes[] = {"e", "ne", "l", "g", "le", "ge"};
+        return codes[op - EQ];
+    }
+
+    const char *negatedConditionCode(Opcode op) {
+        static const char *const codes[] = {"ne", "e", "ge", "le", "g", "l"};
+        return codes[op - EQ];
+    }
+
+    bool isComparison(Opcode op) {
+        return op >= EQ && op <= GE;
+    }
+
+    // Calls clobber r10 and r11
+    bool isCall(Opcode op) {
+        return op == CALL || op == PRINT || op == PRINTI;
+    }
+
+    // Register written by an instruction, or -1
+    int definedRegister(const Instruction &instruction) {
+        switch (instruction.op) {
+            case JUMP: case JUMPZ: case JUMPNZ: case RET: case RETVOID: case PRINT: case PRINTI: case OPCODE_COUNT:
+                return -1;
+            default:
+                return instruction.a;
+        }
+    }
+
+    // Calls f(register) for every register an instruction reads
+    template <typename F>
+    void forEachUse(const Instruction &instruction, F f) {
+        switch (instruction.op) {
+            case LOADK: case JUMP: case RETVOID: case PRINT: case OPCODE_COUNT:
+                break;
+            case MOVE: case TRUNCB: case NOT:
+                f(instruction.b);
+                break;
+            case JUMPZ: case JUMPNZ: case RET: case PRINTI:
+                f(instruction.a);
+                break;
+            case CALL:
+                for (int arg = 0; arg < instruction.c; ++arg) {
+                    f(instruction.a + arg);
+                }
+                break;
+            default:
+                f(instruction.b);
+                f(instruction.c);
+                break;
+        }
+    }
+
+    /* One value of a bytecode register: the definitions and uses connected
+       through the places where the register is live. The bytecode reuses the
+       register of a temporary for the next statement, those become separate
+       live ranges. */
+    struct LiveRange {
+        // First and last instruction where the value is live or written
+        int start = -1;
+        int end = -1;
+        bool crosses_call = false;
+        // Read by a call or live across one
+        bool at_call = false;
+        int definitions = 0;
+        // Set by a single LOADK: the constant is used as an immediate operand
+        // and the value takes no register
+        bool immediate = false;
+        int32_t constant = 0;
+        // Machine register, or -1 when spilled
+        int location = -1;
+        int spill_slot = -1;
+    };
+
+    class FunctionEmitter {
+    public:
+        FunctionEmitter(const Program &program, const Function &function, int index, std::ostream &out)
+            : program(program), function(function), index(index), out(out) {}
+
+        void emit() {
+            const std::vector<Instruction> &code = function.code;
+            findReachable();
+            computeLiveness();
+            buildLiveRanges();
+            allocateRegisters();
+
+            std::vector<bool> targets(code.size() + 1);
+            int last = 0;
+            for (size_t pc = 0; pc < code.size(); ++pc) {
+                if (!reachable[pc]) continue;
+                last = static_cast<int>(pc);
+                const Instruction &instruction = code[pc];
+                if (instruction.op == JUMP) targets[instruction.a] = true;
+                if (instruction.op == JUMPZ || instruction.op == JUMPNZ) targets[instruction.b] = true;
+            }
+
+            emitPrologue();
+            for (int pc = 0; pc < static_cast<int>(code.size()); ++pc) {
+                if (!reachable[pc]) continue;
+                if (targets[pc]) out << label(pc) << ":\n";
+                const Instruction &instruction = code[pc];
+
+                // A comparison feeding only the following branch sets the flags for it
+                if (isComparison(instruction.op) && pc + 1 < static_cast<int>(code.size()) && !targets[pc + 1]) {
+                    const Instruction &next = code[pc + 1];
+                    if ((next.op == JUMPZ || next.op == JUMPNZ) && next.a == instruction.a &&
+                        !liveAfter(instruction.a, pc + 1)) {
+                        compare(instruction, pc);
+                        out << "\tj" << (next.op == JUMPZ ? negatedConditionCode(instruction.op)
+                                                          : conditionCode(instruction.op))
+                            << " " << label(next.b) << "\n";
+                        ++pc;
+                        continue;
+                    }
+                }
+
+                // A temporary copied into a variable right away is written
+                // there directly. Nothing runs in between and the temporary
+                // is not read again, so the variable may take its value early.
+                if (definedRegister(instruction) >= 0 && instruction.op != LOADK &&
+                    pc + 1 < static_cast<int>(code.size()) && !targets[pc + 1]) {
+                    const Instruction &next = code[pc + 1];
+                    if (next.op == MOVE && next.b == instruction.a && next.a != next.b &&
+                        !liveAfter(next.b, pc + 1)) {
+                        destination_override = &ranges[range_of_node[definitionNode(pc + 1)]];
+                        emitInstruction(instruction, pc, pc + 1 == last);
+                        destination_override = nullptr;
+                        ++pc;
+                        continue;
+                    }
+                }
+                emitInstruction(instruction, pc, pc == last);
+            }
+            emitEpilogue();
+        }
+
+    private:
+        const Program &program;
+        const Function &function;
+        int index;
+        std::ostream &out;
+
+        std::vector<bool> reachable;
+        // Bit sets of registers per instruction, words_per_set words each
+        int registers = 0;
+        int words_per_set = 0;
+        std::vector<uint64_t> live_in;
+        // Nodes of an instruction: one per register live before it, then one
+        // for the register it writes
+        std::vector<int> first_node;
+        std::vector<int> range_of_node;
+        std::vector<LiveRange> ranges;
+        // Destination replacing the written register, see emit()
+        const LiveRange *destination_override = nullptr;
+
+        std::vector<bool> saved;
+        int saved_count = 0;
+        int spill_slots = 0;
+
+        uint64_t *set(std::vector<uint64_t> &sets, int pc) {
+            return sets.data() + static_cast<size_t>(pc) * words_per_set;
+        }
+
+        const uint64_t *set(const std::vector<uint64_t> &sets, int pc) const {
+            return sets.data() + static_cast<size_t>(pc) * words_per_set;
+        }
+
+        static bool contains(const uint64_t *bits, int reg) {
+            return (bits[reg / 64] >> (reg % 64)) & 1;
+        }
+
+        // Following instructions; returns how many
+        int successors(int pc, int next[2]) const {
+            const Instruction &instruction = function.code[pc];
+            int count = 0;
+            switch (instruction.op) {
+                case JUMP:
+                    next[count++] = instruction.a;
+                    break;
+                case RET: case RETVOID:
+                    break;
+                case JUMPZ: case JUMPNZ:
+                    next[count++] = instruction.b;
+                    next[count++] = pc + 1;
+                    break;
+                default:
+                    next[count++] = pc + 1;
+                    break;
+            }
+            return count;
+        }
+
+        void findReachable() {
+            reachable.assign(function.code.size() + 1, false);
+            std::vector<int> work = {0};
+            reachable[0] = true;
+            while (!work.empty()) {
+                int pc = work.back();
+                work.pop_back();
+                if (pc >= static_cast<int>(function.code.size())) continue;
+                int next[2];
+                for (int i = successors(pc, next) - 1; i >= 0; --i) {
+                    if (!reachable[next[i]]) {
+                        reachable[next[i]] = true;
+                        work.push_back(next[i]);
+                    }
+                }
+            }
+        }
+
+        bool liveAfter(int reg, int pc) const {
+            int next[2];
+            for (int i = successors(pc, next) - 1; i >= 0; --i) {
+                if (next[i] < static_cast<int>(function.code.size()) && contains(set(live_in, next[i]), reg)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Backward data flow until nothing changes; unreachable code stays empty
+        void computeLiveness() {
+            const std::vector<Instruction> &code = function.code;
+            int size = static_cast<int>(code.size());
+            registers = std::max(function.frame_size, function.arguments);
+            words_per_set = (registers + 63) / 64;
+            live_in.assign(static_cast<size_t>(size) * words_per_set, 0);
+            std::vector<uint64_t> live_out(words_per_set);
+
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (int pc = size - 1; pc >= 0; --pc) {
+                    if (!reachable[pc]) continue;
+                    std::fill(live_out.begin(), live_out.end(), 0);
+                    int next[2];
+                    for (int i = successors(pc, next) - 1; i >= 0; --i) {
+                        if (next[i] >= size) continue;
+                        const uint64_t *in = set(live_in, next[i]);
+                        for (int word = 0; word < words_per_set; ++word) {
+                            live_out[word] |= in[word];
+                        }
+                    }
+                    int defined = definedRegister(code[pc]);
+                    if (defined >= 0) live_out[defined / 64] &= ~(uint64_t(1) << (defined % 64));
+                    forEachUse(code[pc], [&live_out](int reg) { live_out[reg / 64] |= uint64_t(1) << (reg % 64); });
+
+                    uint64_t *in = set(live_in, pc);
+                    if (!std::equal(live_out.begin(), live_out.end(), in)) {
+                        std::copy(live_out.begin(), live_out.end(), in);
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        // Node of the value a register holds before an instruction
+        int useNode(int reg, int pc) const {
+            const uint64_t *bits = set(live_in, pc);
+            int rank = 0;
+            for (int word = 0; word < reg / 64; ++word) {
+                rank += __builtin_popcountll(bits[word]);
+            }
+            rank += __builtin_popcountll(bits[reg / 64] & ((uint64_t(1) << (reg % 64)) - 1));
+            return first_node[pc] + rank;
+        }
+
+        // Node of the value an instruction writes
+        int definitionNode(int pc) const {
+            return first_node[pc + 1] - 1;
+        }
+
+        static int find(std::vector<int> &parent, int node) {
+            while (parent[node] != node) {
+                parent[node] = parent[parent[node]];
+                node = parent[node];
+            }
+            return node;
+        }
+
+        LiveRange &use(int reg, int pc) {
+            return ranges[range_of_node[useNode(reg, pc)]];
+        }
+
+        const LiveRange &use(int reg, int pc) const {
+            return ranges[range_of_node[useNode(reg, pc)]];
+        }
+
+        const LiveRange &definition(int pc) const {
+            if (destination_override) return *destination_override;
+            return ranges[range_of_node[definitionNode(pc)]];
+        }
+
+        // Joins the nodes along every edge the register is live on; each
+        // connected group is one live range. A register read and written by
+        // the same instruction holds two values there.
+        void buildLiveRanges() {
+            const std::vector<Instruction> &code = function.code;
+            int size = static_cast<int>(code.size());
+            first_node.assign(size + 1, 0);
+            std::vector<int> node_pc;
+            for (int pc = 0; pc < size; ++pc) {
+                int count = 0;
+                for (int word = 0; word < words_per_set; ++word) {
+                    count += __builtin_popcountll(set(live_in, pc)[word]);
+                }
+                if (reachable[pc] && definedRegister(code[pc]) >= 0) ++count;
+                first_node[pc + 1] = first_node[pc] + count;
+                node_pc.insert(node_pc.end(), count, pc);
+            }
+
+            std::vector<int> parent(first_node[size]);
+            for (size_t i = 0; i < parent.size(); ++i) {
+                parent[i] = static_cast<int>(i);
+            }
+            for (int pc = 0; pc < size; ++pc) {
+                if (!reachable[pc]) continue;
+                int defined = definedRegister(code[pc]);
+                int next[2];
+                for (int i = successors(pc, next) - 1; i >= 0; --i) {
+                    if (next[i] >= size) continue;
+                    const uint64_t *in = set(live_in, next[i]);
+                    for (int reg = 0; reg < registers; ++reg) {
+                        if (!contains(in, reg)) continue;
+                        int from = find(parent, reg == defined ? definitionNode(pc) : useNode(reg, pc));
+                        int to = find(parent, useNode(reg, next[i]));
+                        if (from != to) parent[from] = to;
+                    }
+                }
+            }
+
+            range_of_node.assign(parent.size(), -1);
+            std::vector<int> range_of_root(parent.size(), -1);
+            for (size_t id = 0; id < parent.size(); ++id) {
+                int root = find(parent, static_cast<int>(id));
+                if (range_of_root[root] < 0) {
+                    range_of_root[root] = static_cast<int>(ranges.size());
+                    ranges.emplace_back();
+                    ranges.back().start = node_pc[id];
+                }
+                range_of_node[id] = range_of_root[root];
+                ranges[range_of_root[root]].end = node_pc[id];
+            }
+
+            for (int pc = 0; pc < size; ++pc) {
+                if (!reachable[pc]) continue;
+                const Instruction &instruction = code[pc];
+                int defined = definedRegister(instruction);
+                if (defined >= 0) {
+                    LiveRange &value = ranges[range_of_node[definitionNode(pc)]];
+                    ++value.definitions;
+                    value.immediate = instruction.op == LOADK;
+                    value.constant = instruction.b;
+                }
+                // Values living on after a call need a callee-saved register
+                if (isCall(instruction.op)) {
+                    for (int reg = 0; reg < registers; ++reg) {
+                        if (!contains(set(live_in, pc), reg)) continue;
+                        use(reg, pc).at_call = true;
+                        if (reg != defined && liveAfter(reg, pc)) use(reg, pc).crosses_call = true;
+                    }
+                }
+            }
+            // The prologue copies the arguments out of the argument registers
+            for (int arg = 0; arg < std::min(function.arguments, registers); ++arg) {
+                if (size > 0 && contains(set(live_in, 0), arg)) use(arg, 0).at_call = true;
+            }
+            // Only a register operand can be tested against zero
+            for (int pc = 0; pc < size; ++pc) {
+                const Instruction &instruction = code[pc];
+                if (reachable[pc] && (instruction.op == JUMPZ || instruction.op == JUMPNZ)) {
+                    use(instruction.a, pc).immediate = false;
+                }
+            }
+            for (LiveRange &value : ranges) {
+                if (value.definitions != 1) value.immediate = false;
+            }
+        }
+
+        void spill(LiveRange &value) {
+            value.location = -1;
+            value.spill_slot = spill_slots++;
+        }
+
+        // Linear scan in order of the start of the live ranges
+        void allocateRegisters() {
+            std::vector<LiveRange *> order;
+            for (LiveRange &value : ranges) {
+                if (!value.immediate) order.push_back(&value);
+            }
+            std::stable_sort(order.begin(), order.end(), [](const LiveRange *left, const LiveRange *right) {
+                return left->start < right->start;
+            });
+
+            std::vector<LiveRange *> active;
+            std::vector<bool> free(REGISTER_COUNT, true);
+            saved.assign(CALLEE_SAVED, false);
+            for (LiveRange *current : order) {
+                // A range ending where the next one starts still holds its
+                // register: that instruction may read it after writing the new one
+                for (auto it = active.begin(); it != active.end();) {
+                    if ((*it)->end < current->start) {
+                        free[(*it)->location] = true;
+                        it = active.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+
+                int limit = current->crosses_call ? CALLEE_SAVED : current->at_call ? CALLER_SAVED : REGISTER_COUNT;
+                int chosen = -1;
+                // Caller-saved registers cost no save in the prologue
+                for (int reg = limit - 1; reg >= 0; --reg) {
+                    if (free[reg]) {
+                        chosen = reg;
+                        break;
+                    }
+                }
+
+                if (chosen < 0) {
+                    // Spill whichever usable range lives longest
+                    LiveRange *victim = nullptr;
+                    for (LiveRange *candidate : active) {
+                        if (candidate->location < limit && (!victim || candidate->end > victim->end)) {
+                            victim = candidate;
+                        }
+                    }
+                    if (!victim || victim->end <= current->end) {
+                        spill(*current);
+                        continue;
+                    }
+                    chosen = victim->location;
+                    spill(*victim);
+                    active.erase(std::find(active.begin(), active.end(), victim));
+                }
+
+                current->location = chosen;
+                free[chosen] = false;
+                active.push_back(current);
+                if (chosen < CALLEE_SAVED && !saved[chosen]) {
+                    saved[chosen] = true;
+                    ++saved_count;
+                }
+            }
+        }
+
+        bool inRegister(const LiveRange &value) const {
+            return !value.immediate && value.location >= 0;
+        }
+
+        bool inMemory(const LiveRange &value) const {
+            return !value.immediate && value.location < 0;
+        }
+
+        std::string location(const LiveRange &value) const {
+            if (value.immediate) return "$" + std::to_string(value.constant);
+            if (value.location >= 0) return REGISTERS_32[value.location];
+            // Slots lie below the saved registers
+            return std::to_string(-8 * saved_count - 4 * (value.spill_slot + 1)) + "(%rbp)";
+        }
+
+        std::string label(int pc) const {
+            return ".L" + std::to_string(index) + "_" + std::to_string(pc);
+        }
+
+        void move(const LiveRange &destination, const LiveRange &source) {
+            if (location(destination) == location(source)) return;
+            if (inMemory(destination) && inMemory(source)) {
+                out << "\tmovl " << location(source) << ", %eax\n";
+                out << "\tmovl %eax, " << location(destination) << "\n";
+            } else {
+                out << "\tmovl " << location(source) << ", " << location(destination) << "\n";
+            }
+        }
+
+        // a = b op c for add, sub and imul. Values of different live ranges
+        // may share a register here when the result is written early, see emit()
+        void arithmetic(const Instruction &instruction, int pc, const char *mnemonic, bool commutative, bool byte) {
+            std::string a = location(definition(pc));
+            std::string b = location(use(instruction.b, pc));
+            std::string c = location(use(instruction.c, pc));
+            if (inRegister(definition(pc)) && (a != c || commutative)) {
+                if (a == c) {
+                    out << "\t" << mnemonic << " " << b << ", " << a << "\n";
+                } else {
+                    if (a != b) out << "\tmovl " << b << ", " << a << "\n";
+                    out << "\t" << mnemonic << " " << c << ", " << a << "\n";
+                }
+                if (byte) out << "\tandl $255, " << a << "\n";
+                return;
+            }
+            out << "\tmovl " << b << ", %eax\n";
+            out << "\t" << mnemonic << " " << c << ", %eax\n";
+            if (byte) out << "\tandl $255, %eax\n";
+            out << "\tmovl %eax, " << a << "\n";
+        }
+
+        void divide(const Instruction &instruction, int pc, bool byte) {
+            const LiveRange &divisor = use(instruction.c, pc);
+            int32_t constant = divisor.constant;
+            if (divisor.immediate && constant > 0 && (constant & (constant - 1)) == 0) {
+                // Shifts for powers of two; signed division rounds toward
+                // zero, so negative dividends are biased by 2^k - 1 first
+                int shift = __builtin_ctz(static_cast<uint32_t>(constant));
+                out << "\tmovl " << location(use(instruction.b, pc)) << ", %eax\n";
+                if (shift > 0 && byte) {
+                    out << "\tshrl $" << shift << ", %eax\n";
+                } else if (shift > 0) {
+                    out << "\tmovl %eax, %edx\n";
+                    out << "\tsarl $31, %edx\n";
+                    out << "\tshrl $" << 32 - shift << ", %edx\n";
+                    out << "\taddl %edx, %eax\n";
+                    out << "\tsarl $" << shift << ", %eax\n";
+                }
+                out << "\tmovl %eax, " << location(definition(pc)) << "\n";
+                return;
+            }
+            out << "\tmovl " << location(divisor) << ", %ecx\n";
+            if (!divisor.immediate || divisor.constant == 0) {
+                out << "\ttestl %ecx, %ecx\n";
+                out << "\tje " << DIVISION_BY_ZERO << "\n";
+            }
+            out << "\tmovl " << location(use(instruction.b, pc)) << ", %eax\n";
+            if (byte) {
+                out << "\txorl %edx, %edx\n";
+                out << "\tdivl %ecx\n";
+            } else {
+                out << "\tcltd\n";
+                out << "\tidivl %ecx\n";
+            }
+            out << "\tmovl %eax, " << location(definition(pc)) << "\n";
+        }
+
+        // Sets the flags for b compared with c
+        void compare(const Instruction &instruction, int pc) {
+            const LiveRange &b = use(instruction.b, pc);
+            const LiveRange &c = use(instruction.c, pc);
+            if (inRegister(b) || (inMemory(b) && !inMemory(c))) {
+                out << "\tcmpl " << location(c) << ", " << location(b) << "\n";
+            } else {
+                out << "\tmovl " << location(b) << ", %eax\n";
+                out << "\tcmpl " << location(c) << ", %eax\n";
+            }
+        }
+
+        void call(const Instruction &instruction, int pc) {
+            const Function &callee = program.functions[instruction.b];
+            int stack_arguments = std::max(0, instruction.c - REGISTER_ARGUMENTS);
+            // The stack stays 16-byte aligned at the call
+            int padding = stack_arguments % 2 ? 8 : 0;
+            if (padding) out << "\tsubq $8, %rsp\n";
+            for (int arg = instruction.c - 1; arg >= REGISTER_ARGUMENTS; --arg) {
+                const LiveRange &value = use(instruction.a + arg, pc);
+                if (inRegister(value)) {
+                    out << "\tpushq " << REGISTERS_64[value.location] << "\n";
+                } else if (value.immediate) {
+                    out << "\tpushq " << location(value) << "\n";
+                } else {
+                    out << "\tmovl " << location(value) << ", %eax\n";
+                    out << "\tpushq %rax\n";
+                }
+            }
+            // Values read by a call never live in argument registers, so the moves cannot overwrite each other
+            for (int arg = 0; arg < std::min(instruction.c, REGISTER_ARGUMENTS); ++arg) {
+                out << "\tmovl " << location(use(instruction.a + arg, pc)) << ", " << ARGUMENT_REGISTERS[arg] << "\n";
+            }
+            out << "\tcall " << callee.name << "\n";
+            if (stack_arguments) out << "\taddq $" << 8 * stack_arguments + padding << ", %rsp\n";
+            out << "\tmovl %eax, " << location(definition(pc)) << "\n";
+        }
+
+        void emitInstruction(const Instruction &instruction, int pc, bool last) {
+            switch (instruction.op) {
+                case LOADK: {
+                    const LiveRange &value = definition(pc);
+                    if (!value.immediate) out << "\tmovl $" << instruction.b << ", " << location(value) << "\n";
+                    break;
+                }
+                case MOVE:
+                    move(definition(pc), use(instruction.b, pc));
+                    break;
+                case ADD:
+                    arithmetic(instruction, pc, "addl", true, false);
+                    break;
+                case SUB:
+                    arithmetic(instruction, pc, "subl", false, false);
+                    break;
+                case MUL:
+                    arithmetic(instruction, pc, "imull", true, false);
+                    break;
+                case DIV:
+                    divide(instruction, pc, false);
+                    break;
+                case ADDB:
+                    arithmetic(instruction, pc, "addl", true, true);
+                    break;
+                case SUBB:
+                    arithmetic(instruction, pc, "subl", false, true);
+                    break;
+                case MULB:
+                    arithmetic(instruction, pc, "imull", true, true);
+                    break;
+                case DIVB:
+                    divide(instruction, pc, true);
+                    break;
+                case TRUNCB:
+                    move(definition(pc), use(instruction.b, pc));
+                    out << "\tandl $255, " << location(definition(pc)) << "\n";
+                    break;
+                case EQ: case NE: case LT: case GT: case LE: case GE:
+                    compare(instruction, pc);
+                    out << "\tset" << conditionCode(instruction.op) << " %al\n";
+                    out << "\tmovzbl %al, %eax\n";
+                    out << "\tmovl %eax, " << location(definition(pc)) << "\n";
+                    break;
+                case NOT:
+                    move(definition(pc), use(instruction.b, pc));
+                    out << "\txorl $1, " << location(definition(pc)) << "\n";
+                    break;
+                case JUMP:
+                    out << "\tjmp " << label(instruction.a) << "\n";
+                    break;
+                case JUMPZ: case JUMPNZ:
+                    out << "\tcmpl $0, " << location(use(instruction.a, pc)) << "\n";
+                    out << "\t" << (instruction.op == JUMPZ ? "je " : "jne ") << label(instruction.b) << "\n";
+                    break;
+                case CALL:
+                    call(instruction, pc);
+                    break;
+                case RET:
+                    out << "\tmovl " << location(use(instruction.a, pc)) << ", %eax\n";
+                    if (!last) out << "\tjmp .L" << index << "_return\n";
+                    break;
+                case RETVOID:
+                    if (!last) out << "\tjmp .L" << index << "_return\n";
+                    break;
+                case PRINT:
+                    out << "\tleaq .Lstr" << instruction.a << "(%rip), %rdi\n";
+                    out << "\tmovl $" << program.strings[instruction.a].size() << ", %esi\n";
+                    out << "\tcall print\n";
+                    break;
+                case PRINTI:
+                    out << "\tmovl " << location(use(instruction.a, pc)) << ", %edi\n";
+                    out << "\tcall printi\n";
+                    break;
+                case OPCODE_COUNT:
+                    break;
+            }
+        }
+
+        void emitPrologue() {
+            out << "\t.p2align 4\n";
+            out << "\t.type " << function.name << ", @function\n";
+            out << function.name << ":\n";
+            out << "\tpushq %rbp\n";
+            out << "\tmovq %rsp, %rbp\n";
+            for (int reg = 0; reg < CALLEE_SAVED; ++reg) {
+                if (saved[reg]) out << "\tpushq " << REGISTERS_64[reg] << "\n";
+            }
+            int frame = 4 * spill_slots;
+            frame += (16 - (8 * saved_count + frame) % 16) % 16;
+            if (frame) out << "\tsubq $" << frame << ", %rsp\n";
+
+            // Only arguments live at the first instruction are read
+            for (int arg = 0; arg < function.arguments; ++arg) {
+                if (function.code.empty() || !contains(set(live_in, 0), arg)) continue;
+                const LiveRange &value = use(arg, 0);
+                if (arg < REGISTER_ARGUMENTS) {
+                    out << "\tmovl " << ARGUMENT_REGISTERS[arg] << ", " << location(value) << "\n";
+                } else {
+                    std::string incoming = std::to_string(16 + 8 * (arg - REGISTER_ARGUMENTS)) + "(%rbp)";
+                    if (inRegister(value)) {
+                        out << "\tmovl " << incoming << ", " << location(value) << "\n";
+                    } else {
+                        out << "\tmovl " << incoming << ", %eax\n";
+                        out << "\tmovl %eax, " << location(value) << "\n";
+                    }
+                }
+            }
+        }
+
+        void emitEpilogue() {
+            out << ".L" << index << "_return:\n";
+            if (saved_count) {
+                out << "\tleaq " << -8 * saved_count << "(%rbp), %rsp\n";
+                for (int reg = CALLEE_SAVED - 1; reg >= 0; --reg) {
+                    if (saved[reg]) out << "\tpopq " << REGISTERS_64[reg] << "\n";
+                }
+                out << "\tpopq %rbp\n";
+            } else {
+                out << "\tleave\n";
+            }
+            out << "\tret\n";
+            out << "\t.size " << function.name << ", .-" << function.name << "\n";
+        }
+    };
+
+    // Operand of .asciz with everything but plain printable characters escaped in octal
+    std::string quote(const std::string &bytes) {
+        std::string quoted = "\"";
+        for (unsigned char byte : bytes) {
+            if (byte >= 0x20 && byte < 0x7f && byte != '"' && byte != '\\') {
+                quoted += static_cast<char>(byte);
+            } else {
+                char escape[5];
+                std::snprintf(escape, sizeof(escape), "\\%03o", byte);
+                quoted += escape;
+            }
+        }
+        return quoted + "\"";
+    }
+}
+
+std::string generateAssembly(const bytecode::Program &program) {
+    std::ostringstream out;
+    out << "\t.text\n";
+    bool divides = false;
+    for (size_t i = 0; i < program.functions.size(); ++i) {
+        const bytecode::Function &function = program.functions[i];
+        if (static_cast<int>(i) == program.main) out << "\t.globl " << function.name << "\n";
+        FunctionEmitter(program, function, static_cast<int>(i), out).emit();
+        for (const bytecode::Instruction &instruction : function.code) {
+            if (instruction.op == bytecode::DIV || instruction.op == bytecode::DIVB) divides = true;
+        }
+    }
+
+    // Jumped to with the stack aligned; never returns
+    if (divides) {
+        out << DIVISION_BY_ZERO << ":\n";
+        out << "\tcall .division_error\n";
+    }
+
+    if (!program.strings.empty()) out << "\t.section .rodata\n";
+    for (size_t i = 0; i < program.strings.size(); ++i) {
+        out << ".Lstr" << i << ":\n";
+        out << "\t.asciz " << quote(program.strings[i]) << "\n";
+    }
+    out << "\t.section .note.GNU-stack,\"\",@progbits\n";
+    return out.str();
+}
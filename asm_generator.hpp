@@ -0,0 +1,21 @@
+#ifndef ASM_GENERATOR_HPP
+#define ASM_GENERATOR_HPP
+
+#include <string>
+#include "bytecode.hpp"
+
+/* x86-64 backend producing GNU assembler source for the System V ABI.
+   It starts from the register bytecode of the interpreter, whose registers
+   already name every local variable and temporary of a function. Their live
+   intervals are computed over the instruction order, stretched over the
+   loops they live through, and given machine registers by linear scan; the
+   rest are spilled to the stack frame. FanC functions are ordinary C
+   functions: arguments in edi, esi, edx, ecx, r8d, r9d and then on the
+   stack, the result in eax.
+
+   The output is meant for the native runtime (runtime/fanc_runtime.c), which
+   provides print, printi and the division by zero message and is linked with
+   --wrap=main like the objects of the LLVM path. */
+std::string generateAssembly(const bytecode::Program &program);
+
+#endif // ASM_GENERATOR_HPP
@@ -0,0 +1,103 @@
+#include "ast_walker.hpp"
+
+void AstWalker::visit(ast::Num &node) {}
+
+void AstWalker::visit(ast::NumB &node) {}
+
+void AstWalker::visit(ast::String &node) {}
+
+void AstWalker::visit(ast::Bool &node) {}
+
+void AstWalker::visit(ast::ID &node) {}
+
+void AstWalker::visit(ast::BinOp &node) {
+    node.left->accept(*this);
+    node.right->accept(*this);
+}
+
+void AstWalker::visit(ast::RelOp &node) {
+    node.left->accept(*this);
+    node.right->accept(*this);
+}
+
+void AstWalker::visit(ast::Not &node) {
+    node.exp->accept(*this);
+}
+
+void AstWalker::visit(ast::And &node) {
+    node.left->accept(*this);
+    node.right->accept(*this);
+}
+
+void AstWalker::visit(ast::Or &node) {
+    node.left->accept(*this);
+    node.right->accept(*this);
+}
+
+void AstWalker::visit(ast::Type &node) {}
+
+void AstWalker::visit(ast::Cast &node) {
+    node.exp->accept(*this);
+}
+
+void AstWalker::visit(ast::ExpList &node) {
+    for (auto& exp : node.exps) {
+        exp->accept(*this);
+    }
+}
+
+void AstWalker::visit(ast::Call &node) {
+    if (node.args) node.args->accept(*this);
+}
+
+void AstWalker::visit(ast::Statements &node) {
+    for (auto& statement : node.statements) {
+        statement->accept(*this);
+    }
+}
+
+void AstWalker::visit(ast::Break &node) {}
+
+void AstWalker::visit(ast::Continue &node) {}
+
+void AstWalker::visit(ast::Return &node) {
+    if (node.exp) node.exp->accept(*this);
+}
+
+void AstWalker::visit(ast::If &node) {
+    node.condition->accept(*this);
+    node.then->accept(*this);
+    if (node.otherwise) node.otherwise->accept(*this);
+}
+
+void AstWalker::visit(ast::While &node) {
+    node.condition->accept(*this);
+    node.body->accept(*this);
+}
+
+void AstWalker::visit(ast::VarDecl &node) {
+    if (node.init_exp) node.init_exp->accept(*this);
+}
+
+void AstWalker::visit(ast::Assign &node) {
+    node.exp->accept(*this);
+}
+
+void AstWalker::visit(ast::Formal &node) {}
+
+void AstWalker::visit(ast::Formals &node) {
+    for (auto& formal : node.formals) {
+        formal->accept(*this);
+    }
+}
+
+void AstWalker::visit(ast::FuncDecl &node) {
+    if (node.formals) node.formals->accept(*this);
+    node.body->accept(*this);
+}
+
+void AstWalker::visit(ast::Funcs &node) {
+    for (auto& func : node.funcs) {
+        func->accept(*this);
+    }
+}
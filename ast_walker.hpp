@@ -0,0 +1,43 @@
+#ifndef AST_WALKER_HPP
+#define AST_WALKER_HPP
+
+#include "visitor.hpp"
+#include "nodes.hpp"
+
+/* Visitor implementation that only walks the tree.
+   Children are visited in the same order the code generator evaluates them, so
+   analyses derived from this class see nodes in emission order and only need to
+   override the node types they are interested in. Identifiers that name a
+   function, a declared variable or a formal are not visited as expressions. */
+
+class AstWalker : public Visitor {
+public:
+    void visit(ast::Num &node) override;
+    void visit(ast::NumB &node) override;
+    void visit(ast::String &node) override;
+    void visit(ast::Bool &node) override;
+    void visit(ast::ID &node) override;
+    void visit(ast::BinOp &node) override;
+    void visit(ast::RelOp &node) override;
+    void visit(ast::Not &node) override;
+    void visit(ast::And &node) override;
+    void visit(ast::Or &node) override;
+    void visit(ast::Type &node) override;
+    void visit(ast::Cast &node) override;
+    void visit(ast::ExpList &node) override;
+    void visit(ast::Call &node) override;
+    void visit(ast::Statements &node) override;
+    void visit(ast::Break &node) override;
+    void visit(ast::Continue &node) override;
+    void visit(ast::Return &node) override;
+    void visit(ast::If &node) override;
+    void visit(ast::While &node) override;
+    void visit(ast::VarDecl &node) override;
+    void visit(ast::Assign &node) override;
+    void visit(ast::Formal &node) override;
+    void visit(ast::Formals &node) override;
+    void visit(ast::FuncDecl &node) override;
+    void visit(ast::Funcs &node) override;
+};
+
+#endif // AST_WALKER_HPP
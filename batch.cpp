@@ -0,0 +1,109 @@
+#include "batch.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+    struct BatchEntry {
+        fs::path source;
+        fs::path target;
+        // Empty when the file was compiled; "error" for diagnostics, otherwise an I/O problem
+        std::string status;
+        double milliseconds = 0;
+    };
+
+    std::vector<fs::path> listSources(const std::string &input) {
+        std::vector<fs::path> sources;
+        if (fs::is_directory(input)) {
+            for (const auto& entry : fs::directory_iterator(input)) {
+                if (entry.is_regular_file() && entry.path().extension() == ".in") {
+                    sources.push_back(entry.path());
+                }
+            }
+            std::sort(sources.begin(), sources.end());
+        } else {
+            std::ifstream list(input);
+            std::string line;
+            while (std::getline(list, line)) {
+                if (!line.empty()) sources.push_back(line);
+            }
+        }
+        return sources;
+    }
+
+    void compileEntry(BatchEntry &entry, const fanc::Options &options) {
+        auto start = std::chrono::steady_clock::now();
+
+        std::ifstream in(entry.source, std::ios::binary);
+        if (!in) {
+            entry.status = "cannot read";
+            return;
+        }
+        std::stringstream source;
+        source << in.rdbuf();
+
+        fanc::Result result = fanc::compile(source.str(), options);
+        auto end = std::chrono::steady_clock::now();
+        entry.milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+        if (!result.ok) entry.status = "error";
+
+        std::ofstream out(entry.target, std::ios::binary);
+        out << (result.ok ? result.ir : result.diagnostics);
+        if (!out) entry.status = "cannot write";
+    }
+}
+
+int compileBatch(const std::string &input, const std::string &out_dir, unsigned jobs,
+                 const fanc::Options &options, std::ostream &report) {
+    if (!fs::exists(input)) {
+        report << "batch: " << input << " does not exist" << std::endl;
+        return 1;
+    }
+
+    std::vector<BatchEntry> entries;
+    for (const auto& source : listSources(input)) {
+        BatchEntry entry;
+        entry.source = source;
+        fs::path directory = out_dir.empty() ? source.parent_path() : fs::path(out_dir);
+        entry.target = directory / source.stem();
+        entry.target += options.backend == fanc::Backend::ASM ? ".s" : ".ll";
+        entries.push_back(entry);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        ThreadPool pool(std::min<size_t>(ThreadPool::defaultThreads(jobs), std::max<size_t>(entries.size(), 1)));
+        for (auto& entry : entries) {
+            pool.submit([&entry, &options] { compileEntry(entry, options); });
+        }
+        pool.wait();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    int failures = 0;
+    int diagnosed = 0;
+    double total = 0;
+    report << std::fixed << std::setprecision(3);
+    for (const auto& entry : entries) {
+        total += entry.milliseconds;
+        if (entry.status == "error") {
+            ++diagnosed;
+        } else if (!entry.status.empty()) {
+            ++failures;
+        }
+        report << std::setw(10) << entry.milliseconds << " ms  " << entry.source.string();
+        if (!entry.status.empty()) report << "  (" << entry.status << ")";
+        report << "\n";
+    }
+    report << "batch: " << entries.size() << " files, " << diagnosed << " with diagnostics, "
+           << failures << " failed, " << total << " ms compiling, "
+           << std::chrono::duration<double, std::milli>(end - start).count() << " ms wall" << std::endl;
+    return failures;
+}
@@ -0,0 +1,20 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <iostream>
+#include <string>
+#include "fanc.hpp"
+
+/* Batch compilation: compiles many FanC sources inside one process.
+   input is either a directory (every *.in file in it) or a text file listing
+   one source path per line. Every source is compiled on a thread pool of
+   jobs threads and <stem>.ll (<stem>.s with the asm backend) is written next
+   to the source, or into out_dir when it is not empty. The file holds
+   exactly what the single-file compiler would print: the generated code, or
+   the diagnostic. A per-file timing summary
+   is written to report. Returns the number of sources that could not be
+   read or written. */
+int compileBatch(const std::string &input, const std::string &out_dir, unsigned jobs,
+                 const fanc::Options &options, std::ostream &report);
+
+#endif // BATCH_HPP
@@ -0,0 +1,392 @@
+#include "bytecode.hpp"
+#include <algorithm>
+#include <cctype>
+
+namespace bytecode {
+
+    std::string constantBytes(const std::string &literal) {
+        std::string bytes;
+        auto hex = [&literal](size_t i) { return std::isxdigit(static_cast<unsigned char>(literal[i])) != 0; };
+        for (size_t i = 0; i < literal.size(); ++i) {
+            if (literal[i] == '\\' && i + 1 < literal.size() && literal[i + 1] == '\\') {
+                bytes += '\\';
+                ++i;
+            } else if (literal[i] == '\\' && i + 2 < literal.size() && hex(i + 1) && hex(i + 2)) {
+                bytes += static_cast<char>(std::stoi(literal.substr(i + 1, 2), nullptr, 16));
+                i += 2;
+            } else {
+                bytes += literal[i];
+            }
+        }
+        return bytes;
+    }
+
+    Compiler::Compiler(Program &program)
+        : program(program), function(nullptr), top(0), result(0), result_type(ast::BuiltInType::VOID) {}
+
+    int Compiler::allocate() {
+        int reg = top++;
+        function->frame_size = std::max(function->frame_size, top);
+        return reg;
+    }
+
+    size_t Compiler::emit(Opcode op, int32_t a, int32_t b, int32_t c) {
+        function->code.push_back({op, a, b, c});
+        return function->code.size() - 1;
+    }
+
+    void Compiler::patch(size_t index) {
+        Instruction &jump = function->code[index];
+        if (jump.op == JUMP) {
+            jump.a = here();
+        } else {
+            jump.b = here();
+        }
+    }
+
+    int Compiler::here() const {
+        return static_cast<int>(function->code.size());
+    }
+
+    void Compiler::evaluate(ast::Exp &exp) {
+        exp.accept(*this);
+    }
+
+    Compiler::Variable *Compiler::lookup(const std::string &name) {
+        for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+            auto found = scope->find(name);
+            if (found != scope->end()) return &found->second;
+        }
+        return nullptr;
+    }
+
+    int Compiler::intern(const std::string &literal) {
+        std::string bytes = constantBytes(literal);
+        auto found = string_index.find(bytes);
+        if (found != string_index.end()) return found->second;
+        int index = static_cast<int>(program.strings.size());
+        program.strings.push_back(bytes);
+        string_index[bytes] = index;
+        return index;
+    }
+
+    void Compiler::visit(ast::Funcs &node) {
+        // Indices first, calls may refer to later functions
+        for (const auto &func : node.funcs) {
+            function_index[func->id->value] = static_cast<int>(program.functions.size());
+            return_types[func->id->value] = func->return_type->type;
+            program.functions.emplace_back();
+            program.functions.back().name = func->id->value;
+        }
+        for (const auto &func : node.funcs) {
+            func->accept(*this);
+        }
+        auto main = function_index.find("main");
+        if (main != function_index.end()) program.main = main->second;
+    }
+
+    void Compiler::visit(ast::FuncDecl &node) {
+        function = &program.functions[function_index[node.id->value]];
+        scopes.assign(1, {});
+        loops.clear();
+        top = 0;
+
+        if (node.formals) {
+            for (const auto &formal : node.formals->formals) {
+                scopes.back()[formal->id->value] = {allocate(), formal->type->type};
+            }
+            function->arguments = static_cast<int>(node.formals->formals.size());
+        }
+
+        node.body->accept(*this);
+
+        // Falling off the end returns 0, as in the generated code
+        if (node.return_type->type == ast::BuiltInType::VOID) {
+            emit(RETVOID);
+        } else {
+            int zero = allocate();
+            emit(LOADK, zero, 0);
+            emit(RET, zero);
+        }
+        function->frame_size = std::max(function->frame_size, 1);
+    }
+
+    void Compiler::visit(ast::Statements &node) {
+        scopes.push_back({});
+        int locals = top;
+        for (const auto &statement : node.statements) {
+            statement->accept(*this);
+            // Temporaries die with the statement, variables with the scope
+            top = locals + static_cast<int>(scopes.back().size());
+        }
+        top = locals;
+        scopes.pop_back();
+    }
+
+    void Compiler::visit(ast::VarDecl &node) {
+        int reg = top;
+        if (node.init_exp) {
+            evaluate(*node.init_exp);
+            top = reg;
+            allocate();
+            if (result != reg) emit(MOVE, reg, result);
+        } else {
+            allocate();
+            emit(LOADK, reg, 0);
+        }
+        scopes.back()[node.id->value] = {reg, node.type->type};
+    }
+
+    void Compiler::visit(ast::Assign &node) {
+        Variable *variable = lookup(node.id->value);
+        if (!variable) return;
+        int mark = top;
+        evaluate(*node.exp);
+        if (result != variable->reg) emit(MOVE, variable->reg, result);
+        top = mark;
+    }
+
+    void Compiler::visit(ast::ID &node) {
+        Variable *variable = lookup(node.value);
+        if (variable) {
+            result = variable->reg;
+            result_type = variable->type;
+        } else {
+            result = allocate();
+            emit(LOADK, result, 0);
+            result_type = ast::BuiltInType::INT;
+        }
+    }
+
+    void Compiler::visit(ast::Num &node) {
+        result = allocate();
+        emit(LOADK, result, node.value);
+        result_type = ast::BuiltInType::INT;
+    }
+
+    void Compiler::visit(ast::NumB &node) {
+        result = allocate();
+        emit(LOADK, result, node.value);
+        result_type = ast::BuiltInType::BYTE;
+    }
+
+    void Compiler::visit(ast::Bool &node) {
+        result = allocate();
+        emit(LOADK, result, node.value ? 1 : 0);
+        result_type = ast::BuiltInType::BOOL;
+    }
+
+    void Compiler::visit(ast::String &node) {
+        // Strings only reach print, which takes the index directly
+        result = allocate();
+        emit(LOADK, result, intern(node.value));
+        result_type = ast::BuiltInType::STRING;
+    }
+
+    void Compiler::visit(ast::BinOp &node) {
+        int mark = top;
+        evaluate(*node.left);
+        int left = result;
+        ast::BuiltInType left_type = result_type;
+        evaluate(*node.right);
+        int right = result;
+        ast::BuiltInType right_type = result_type;
+
+        // Operands are read before the destination is written, so it may reuse their registers
+        top = mark;
+        result = allocate();
+        bool is_byte_op = left_type == ast::BuiltInType::BYTE && right_type == ast::BuiltInType::BYTE;
+        static const Opcode int_ops[] = {ADD, SUB, MUL, DIV};
+        static const Opcode byte_ops[] = {ADDB, SUBB, MULB, DIVB};
+        emit(is_byte_op ? byte_ops[node.op] : int_ops[node.op], result, left, right);
+        result_type = is_byte_op ? ast::BuiltInType::BYTE : ast::BuiltInType::INT;
+    }
+
+    void Compiler::visit(ast::RelOp &node) {
+        int mark = top;
+        evaluate(*node.left);
+        int left = result;
+        evaluate(*node.right);
+        int right = result;
+
+        top = mark;
+        result = allocate();
+        static const Opcode compare_ops[] = {EQ, NE, LT, GT, LE, GE};
+        emit(compare_ops[node.op], result, left, right);
+        result_type = ast::BuiltInType::BOOL;
+    }
+
+    void Compiler::visit(ast::Not &node) {
+        int mark = top;
+        evaluate(*node.exp);
+        int operand = result;
+        top = mark;
+        result = allocate();
+        emit(NOT, result, operand);
+        result_type = ast::BuiltInType::BOOL;
+    }
+
+    void Compiler::visit(ast::And &node) {
+        int mark = top;
+        evaluate(*node.left);
+        int left = result;
+        top = mark;
+        int value = allocate();
+        if (left != value) emit(MOVE, value, left);
+        size_t skip = emit(JUMPZ, value);
+
+        evaluate(*node.right);
+        if (result != value) emit(MOVE, value, result);
+        patch(skip);
+
+        top = value + 1;
+        result = value;
+        result_type = ast::BuiltInType::BOOL;
+    }
+
+    void Compiler::visit(ast::Or &node) {
+        int mark = top;
+        evaluate(*node.left);
+        int left = result;
+        top = mark;
+        int value = allocate();
+        if (left != value) emit(MOVE, value, left);
+        size_t skip = emit(JUMPNZ, value);
+
+        evaluate(*node.right);
+        if (result != value) emit(MOVE, value, result);
+        patch(skip);
+
+        top = value + 1;
+        result = value;
+        result_type = ast::BuiltInType::BOOL;
+    }
+
+    void Compiler::visit(ast::Cast &node) {
+        int mark = top;
+        evaluate(*node.exp);
+        if (node.target_type->type == ast::BuiltInType::BYTE && result_type != ast::BuiltInType::BYTE) {
+            int operand = result;
+            top = mark;
+            result = allocate();
+            emit(TRUNCB, result, operand);
+        }
+        result_type = node.target_type->type;
+    }
+
+    void Compiler::visit(ast::Call &node) {
+        const std::string &name = node.func_id->value;
+        int mark = top;
+
+        if (name == "print") {
+            if (auto literal = std::dynamic_pointer_cast<ast::String>(node.args->exps[0])) {
+                emit(PRINT, intern(literal->value));
+            }
+            result_type = ast::BuiltInType::VOID;
+            return;
+        }
+        if (name == "printi") {
+            evaluate(*node.args->exps[0]);
+            emit(PRINTI, result);
+            top = mark;
+            result_type = ast::BuiltInType::VOID;
+            return;
+        }
+
+        // The arguments go to consecutive registers, the callee's frame starts at the first
+        size_t count = node.args ? node.args->exps.size() : 0;
+        int base = top;
+        for (size_t i = 0; i < count; ++i) {
+            allocate();
+        }
+        for (size_t i = 0; i < count; ++i) {
+            // Evaluated right in its slot, the later slots are still free
+            int target = base + static_cast<int>(i);
+            top = target;
+            evaluate(*node.args->exps[i]);
+            if (result != target) emit(MOVE, target, result);
+        }
+        top = base;
+        int value = allocate();
+        emit(CALL, base, function_index.at(name), static_cast<int32_t>(count));
+
+        // Like the generated code, byte results are treated as int
+        ast::BuiltInType return_type = return_types.at(name);
+        result = value;
+        if (return_type == ast::BuiltInType::VOID || return_type == ast::BuiltInType::BOOL) {
+            result_type = return_type;
+        } else {
+            result_type = ast::BuiltInType::INT;
+        }
+    }
+
+    void Compiler::visit(ast::Return &node) {
+        if (node.exp) {
+            evaluate(*node.exp);
+            emit(RET, result);
+        } else {
+            emit(RETVOID);
+        }
+    }
+
+    void Compiler::visit(ast::If &node) {
+        int locals = top;
+        evaluate(*node.condition);
+        size_t skip_then = emit(JUMPZ, result);
+        top = locals;
+
+        scopes.push_back({});
+        node.then->accept(*this);
+        scopes.pop_back();
+        top = locals;
+
+        if (node.otherwise) {
+            size_t skip_otherwise = emit(JUMP);
+            patch(skip_then);
+            scopes.push_back({});
+            node.otherwise->accept(*this);
+            scopes.pop_back();
+            top = locals;
+            patch(skip_otherwise);
+        } else {
+            patch(skip_then);
+        }
+    }
+
+    void Compiler::visit(ast::While &node) {
+        int locals = top;
+        int check = here();
+        evaluate(*node.condition);
+        size_t exit = emit(JUMPZ, result);
+        top = locals;
+
+        loops.push_back({check, {}});
+        scopes.push_back({});
+        node.body->accept(*this);
+        scopes.pop_back();
+        top = locals;
+        emit(JUMP, check);
+
+        patch(exit);
+        for (size_t jump : loops.back().breaks) {
+            patch(jump);
+        }
+        loops.pop_back();
+    }
+
+    void Compiler::visit(ast::Break &node) {
+        if (!loops.empty()) loops.back().breaks.push_back(emit(JUMP));
+    }
+
+    void Compiler::visit(ast::Continue &node) {
+        if (!loops.empty()) emit(JUMP, loops.back().continue_target);
+    }
+
+    void Compiler::visit(ast::Type &node) {}
+
+    void Compiler::visit(ast::ExpList &node) {}
+
+    void Compiler::visit(ast::Formal &node) {}
+
+    void Compiler::visit(ast::Formals &node) {}
+}
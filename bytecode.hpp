@@ -0,0 +1,150 @@
+#ifndef BYTECODE_HPP
+#define BYTECODE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "nodes.hpp"
+#include "visitor.hpp"
+
+/* Register based bytecode for the FanC interpreter.
+   Every function works on a frame of 32-bit registers: the arguments are
+   registers 0..n-1, followed by one register per local variable and the
+   temporaries of the expression being evaluated. A call passes its arguments
+   in consecutive registers of the caller, which become registers 0..n-1 of
+   the callee's frame, so arguments are never copied. Values follow the
+   representation of CodeGenerator: everything is an i32, booleans are 0 or
+   1, byte arithmetic is done in 32 bits and truncated to 8. */
+
+namespace bytecode {
+
+    enum Opcode : uint8_t {
+        LOADK,      // a = b
+        MOVE,       // a = reg b
+        ADD,        // a = b + c (32-bit wrap-around)
+        SUB,
+        MUL,
+        DIV,        // a = b / c, signed; prints the division error and exits when c is 0
+        ADDB,       // as ADD, then truncated to a byte
+        SUBB,
+        MULB,
+        DIVB,
+        TRUNCB,     // a = b & 255
+        EQ,         // a = b == c
+        NE,
+        LT,
+        GT,
+        LE,
+        GE,
+        NOT,        // a = b ^ 1
+        JUMP,       // pc = a
+        JUMPZ,      // if reg a == 0: pc = b
+        JUMPNZ,     // if reg a != 0: pc = b
+        CALL,       // a = functions[b](registers a..a+c-1)
+        RET,        // returns reg a
+        RETVOID,
+        PRINT,      // prints strings[a]
+        PRINTI,     // prints reg a
+        OPCODE_COUNT
+    };
+
+    struct Instruction {
+        Opcode op;
+        int32_t a;
+        int32_t b;
+        int32_t c;
+    };
+
+    struct Function {
+        std::string name;
+        int arguments = 0;
+        // Registers the frame needs
+        int frame_size = 0;
+        std::vector<Instruction> code;
+    };
+
+    struct Program {
+        std::vector<Function> functions;
+        std::vector<std::string> strings;
+        int main = -1;
+    };
+
+    // The bytes of a string literal as LLVM reads the constant CodeGenerator
+    // emits for it: \\ is a backslash and \ followed by two hex digits a byte
+    std::string constantBytes(const std::string &literal);
+
+    /* Translates an analyzed program. Only valid programs may be compiled:
+       names are resolved without checks. */
+    class Compiler : public Visitor {
+    public:
+        explicit Compiler(Program &program);
+
+        void visit(ast::Num &node) override;
+        void visit(ast::NumB &node) override;
+        void visit(ast::String &node) override;
+        void visit(ast::Bool &node) override;
+        void visit(ast::ID &node) override;
+        void visit(ast::BinOp &node) override;
+        void visit(ast::RelOp &node) override;
+        void visit(ast::Not &node) override;
+        void visit(ast::And &node) override;
+        void visit(ast::Or &node) override;
+        void visit(ast::Type &node) override;
+        void visit(ast::Cast &node) override;
+        void visit(ast::ExpList &node) override;
+        void visit(ast::Call &node) override;
+        void visit(ast::Statements &node) override;
+        void visit(ast::Break &node) override;
+        void visit(ast::Continue &node) override;
+        void visit(ast::Return &node) override;
+        void visit(ast::If &node) override;
+        void visit(ast::While &node) override;
+        void visit(ast::VarDecl &node) override;
+        void visit(ast::Assign &node) override;
+        void visit(ast::Formal &node) override;
+        void visit(ast::Formals &node) override;
+        void visit(ast::FuncDecl &node) override;
+        void visit(ast::Funcs &node) override;
+
+    private:
+        struct Variable {
+            int reg;
+            ast::BuiltInType type;
+        };
+
+        struct Loop {
+            int continue_target;
+            std::vector<size_t> breaks;
+        };
+
+        Program &program;
+        std::unordered_map<std::string, int> function_index;
+        std::unordered_map<std::string, ast::BuiltInType> return_types;
+        // Index in program.strings of every distinct string
+        std::unordered_map<std::string, int> string_index;
+
+        Function *function;
+        std::vector<std::unordered_map<std::string, Variable>> scopes;
+        std::vector<Loop> loops;
+        // First register not held by a variable or a live temporary
+        int top;
+        // Register and type of the last visited expression
+        int result;
+        ast::BuiltInType result_type;
+
+        int allocate();
+        size_t emit(Opcode op, int32_t a = 0, int32_t b = 0, int32_t c = 0);
+        // Points the jump emitted at index to the next instruction
+        void patch(size_t index);
+        int here() const;
+        // Evaluates an expression; its value is in result afterwards
+        void evaluate(ast::Exp &exp);
+        Variable *lookup(const std::string &name);
+        // Index of the literal's bytes in program.strings, stored once
+        int intern(const std::string &literal);
+    };
+}
+
+#endif // BYTECODE_HPP
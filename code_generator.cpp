@@ -1,13 +1,38 @@
 #include "code_generator.hpp"
+#include "ast_walker.hpp"
+#include "thread_pool.hpp"
+#include "compile_cache.hpp"
+#include "incremental.hpp"
+#include "fingerprint.hpp"
+#include "statistics.hpp"
+#include "constant_propagation.hpp"
+#include "peephole.hpp"
+#include "loop_invariants.hpp"
+#include "induction.hpp"
+#include "unroll.hpp"
+#include "value_numbering.hpp"
+#include <algorithm>
 #include <vector>
 #include <sstream>
 
-CodeGenerator::CodeGenerator(output::CodeBuffer& buffer) 
-    : buffer(buffer), current_reg(""), current_type(ast::BuiltInType::VOID) {
+CodeGenerator::CodeGenerator(output::CodeBuffer& buffer, const fanc::Options& options) 
+    : buffer(buffer), options(options), current_reg(""), current_type(ast::BuiltInType::VOID),
+      functions_table(std::make_shared<std::unordered_map<std::string, ast::BuiltInType>>()),
+      strings(std::make_shared<StringPool>("@.str.")),
+      inline_candidates(std::make_shared<const std::unordered_map<std::string, InlineCandidate>>()),
+      inline_keys(std::make_shared<const std::unordered_map<std::string, std::string>>()),
+      purity(std::make_shared<const Purity>()) {
     // Initialize with a global scope
     beginScope();
 }
 
+CodeGenerator::CodeGenerator(output::CodeBuffer& buffer, const CodeGenerator& parent)
+    : buffer(buffer), options(parent.options), current_reg(""), current_type(ast::BuiltInType::VOID),
+      functions_table(parent.functions_table), strings(parent.strings),
+      inline_candidates(parent.inline_candidates), inline_keys(parent.inline_keys), purity(parent.purity) {
+    beginScope();
+}
+
 void CodeGenerator::beginScope() {
     symbol_table.push_back({});
 }
@@ -49,6 +74,27 @@ static std::string toLLVMType(ast::BuiltInType type) {
     }
 }
 
+// Entries of the table of a memoized function, a power of two: the index is
+// the top memo_bits bits of a multiplicative hash of the arguments
+static const int memo_bits = 10;
+static const int memo_entries = 1 << memo_bits;
+
+// Global holding one part of the table of a memoized function: whether an
+// entry is full, its arguments (key0, key1, ...) or its result (value)
+static std::string memoTable(const std::string& function, const std::string& part) {
+    return "@.memo." + function + "." + part;
+}
+
+// Pointer to the entry at index of one part of a table
+static std::string memoEntry(output::CodeBuffer& buffer, const std::string& function, const std::string& part,
+                             const std::string& type, const std::string& index) {
+    std::string array = "[" + std::to_string(memo_entries) + " x " + type + "]";
+    std::string pointer = buffer.freshVar();
+    buffer.emit(pointer + " = getelementptr " + array + ", " + array + "* " + memoTable(function, part) +
+                ", i64 0, i64 " + index);
+    return pointer;
+}
+
 //Emits LLVM IR for checking division by zero at runtime.
 static void checkDivisionByZero(output::CodeBuffer& buffer, const std::string& divisor_reg) {
     std::string is_zero = buffer.freshVar();
@@ -61,55 +107,377 @@ static void checkDivisionByZero(output::CodeBuffer& buffer, const std::string& d
 
     // Error handling
     buffer.emitLabel(label_error);
-    buffer.emit("call void @print(i8* getelementptr inbounds ([23 x i8], [23 x i8]* @.str_div_err, i32 0, i32 0))");
-    buffer.emit("call void @exit(i32 0)");
-    buffer.emit("br label " + label_continue);
+    buffer.emit("call void @.division_error()");
+    buffer.emit("unreachable");
 
     buffer.emitLabel(label_continue);
 }
 
 
-// ***VISITOR IMPLEMENTATIONS***
+//Names every string literal in emission order, before the function bodies are
+//generated concurrently.
+class StringLiteralCollector : public AstWalker {
+public:
+    explicit StringLiteralCollector(std::vector<std::pair<const ast::String*, std::string>>& literals)
+        : literals(literals) {}
 
-void CodeGenerator::visit(ast::Funcs &node) {
-    global_strings.clear();
-    functions_table.clear();
+    using AstWalker::visit;
+    void visit(ast::String &node) override {
+        literals.push_back({&node, node.value});
+    }
 
-    // Emit standard library declarations and constants
-    buffer.emit("declare i32 @printf(i8*, ...)");
-    buffer.emit("declare void @exit(i32)");
-    buffer.emit("@.int_specifier = constant [4 x i8] c\"%d\\0A\\00\"");
-    buffer.emit("@.str_specifier = constant [4 x i8] c\"%s\\0A\\00\"");
-    buffer.emit("@.str_div_err = constant [23 x i8] c\"Error division by zero\\00\"");
+private:
+    std::vector<std::pair<const ast::String*, std::string>>& literals;
+};
+
+
+//Finds the returns of a function whose value is a call to the function itself.
+class TailRecursionFinder : public AstWalker {
+public:
+    explicit TailRecursionFinder(const std::string& name) : name(name) {}
 
-    // Emit helper functions: printi and print
-    buffer.emit("define void @printi(i32) {");
-    buffer.emit("    %spec_ptr = getelementptr [4 x i8], [4 x i8]* @.int_specifier, i32 0, i32 0");
-    buffer.emit("    call i32 (i8*, ...) @printf(i8* %spec_ptr, i32 %0)");
+    bool found = false;
+
+    using AstWalker::visit;
+    void visit(ast::Return &node) override {
+        auto call = std::dynamic_pointer_cast<ast::Call>(node.exp);
+        if (call && call->func_id->value == name) found = true;
+    }
+
+private:
+    const std::string& name;
+};
+
+
+void CodeGenerator::emitRuntime(output::CodeBuffer& buffer, const LibraryUse& use) {
+    if (!use.any()) return;
+
+    // Output is collected in a buffer and written with write(2) when it fills
+    // up, when main returns (through llvm.global_dtors) and before the exit(0)
+    // of a division by zero
+    buffer.emit("declare i64 @write(i32, i8*, i64)");
+    buffer.emit("declare void @llvm.memcpy.p0i8.p0i8.i64(i8*, i8*, i64, i1)");
+    buffer.emit("@.out_buffer = internal global [65536 x i8] zeroinitializer");
+    buffer.emit("@.out_length = internal global i64 0");
+    buffer.emit("@llvm.global_dtors = appending global [1 x { i32, void ()*, i8* }] "
+                "[{ i32, void ()*, i8* } { i32 65535, void ()* @.flush, i8* null }]");
+
+    // Writes all of the bytes, giving up on an error
+    buffer.emit("define internal void @.write_all(i8* %data, i64 %length) {");
+    buffer.emit("entry:");
+    buffer.emit("    br label %loop");
+    buffer.emit("loop:");
+    buffer.emit("    %done = phi i64 [ 0, %entry ], [ %next, %more ]");
+    buffer.emit("    %left = sub i64 %length, %done");
+    buffer.emit("    %finished = icmp sle i64 %left, 0");
+    buffer.emit("    br i1 %finished, label %end, label %more");
+    buffer.emit("more:");
+    buffer.emit("    %from = getelementptr i8, i8* %data, i64 %done");
+    buffer.emit("    %written = call i64 @write(i32 1, i8* %from, i64 %left)");
+    buffer.emit("    %failed = icmp sle i64 %written, 0");
+    buffer.emit("    %next = add i64 %done, %written");
+    buffer.emit("    br i1 %failed, label %end, label %loop");
+    buffer.emit("end:");
     buffer.emit("    ret void");
     buffer.emit("}");
 
-    buffer.emit("define void @print(i8*) {");
-    buffer.emit("    %spec_ptr = getelementptr [4 x i8], [4 x i8]* @.str_specifier, i32 0, i32 0");
-    buffer.emit("    call i32 (i8*, ...) @printf(i8* %spec_ptr, i8* %0)");
+    // Not internal, the JIT calls it after main
+    buffer.emit("define void @.flush() {");
+    buffer.emit("entry:");
+    buffer.emit("    %length = load i64, i64* @.out_length");
+    buffer.emit("    call void @.write_all(i8* getelementptr inbounds ([65536 x i8], [65536 x i8]* @.out_buffer, i64 0, i64 0), i64 %length)");
+    buffer.emit("    store i64 0, i64* @.out_length");
     buffer.emit("    ret void");
     buffer.emit("}");
 
+    // Appends the text and a newline; text longer than the buffer is written directly
+    buffer.emit("define internal void @.line(i8* %text, i64 %length) {");
+    buffer.emit("entry:");
+    buffer.emit("    %used = load i64, i64* @.out_length");
+    buffer.emit("    %needed = add i64 %used, %length");
+    buffer.emit("    %fits = icmp ult i64 %needed, 65536");
+    buffer.emit("    br i1 %fits, label %copy, label %flush");
+    buffer.emit("flush:");
+    buffer.emit("    call void @.flush()");
+    buffer.emit("    %small = icmp ult i64 %length, 65536");
+    buffer.emit("    br i1 %small, label %copy, label %direct");
+    buffer.emit("direct:");
+    buffer.emit("    call void @.write_all(i8* %text, i64 %length)");
+    buffer.emit("    br label %copy_newline");
+    buffer.emit("copy:");
+    buffer.emit("    %at = load i64, i64* @.out_length");
+    buffer.emit("    %to = getelementptr [65536 x i8], [65536 x i8]* @.out_buffer, i64 0, i64 %at");
+    buffer.emit("    call void @llvm.memcpy.p0i8.p0i8.i64(i8* %to, i8* %text, i64 %length, i1 false)");
+    buffer.emit("    %copied = add i64 %at, %length");
+    buffer.emit("    br label %copy_newline");
+    buffer.emit("copy_newline:");
+    buffer.emit("    %end = phi i64 [ %copied, %copy ], [ 0, %direct ]");
+    buffer.emit("    %newline = getelementptr [65536 x i8], [65536 x i8]* @.out_buffer, i64 0, i64 %end");
+    buffer.emit("    store i8 10, i8* %newline");
+    buffer.emit("    %total = add i64 %end, 1");
+    buffer.emit("    store i64 %total, i64* @.out_length");
+    buffer.emit("    ret void");
+    buffer.emit("}");
+
+    // Digits from the last one backwards, the magnitude is unsigned so INT_MIN works
+    if (use.printi) {
+        buffer.emit("define void @printi(i32) {");
+        buffer.emit("entry:");
+        buffer.emit("    %digits = alloca [11 x i8]");
+        buffer.emit("    %negative = icmp slt i32 %0, 0");
+        buffer.emit("    %negated = sub i32 0, %0");
+        buffer.emit("    %magnitude = select i1 %negative, i32 %negated, i32 %0");
+        buffer.emit("    br label %loop");
+        buffer.emit("loop:");
+        buffer.emit("    %rest = phi i32 [ %magnitude, %entry ], [ %quotient, %loop ]");
+        buffer.emit("    %position = phi i64 [ 11, %entry ], [ %index, %loop ]");
+        buffer.emit("    %quotient = udiv i32 %rest, 10");
+        buffer.emit("    %tens = mul i32 %quotient, 10");
+        buffer.emit("    %digit = sub i32 %rest, %tens");
+        buffer.emit("    %code = add i32 %digit, 48");
+        buffer.emit("    %character = trunc i32 %code to i8");
+        buffer.emit("    %index = sub i64 %position, 1");
+        buffer.emit("    %slot = getelementptr [11 x i8], [11 x i8]* %digits, i64 0, i64 %index");
+        buffer.emit("    store i8 %character, i8* %slot");
+        buffer.emit("    %more = icmp ne i32 %quotient, 0");
+        buffer.emit("    br i1 %more, label %loop, label %sign");
+        buffer.emit("sign:");
+        buffer.emit("    br i1 %negative, label %minus, label %emit");
+        buffer.emit("minus:");
+        buffer.emit("    %minus_index = sub i64 %index, 1");
+        buffer.emit("    %minus_slot = getelementptr [11 x i8], [11 x i8]* %digits, i64 0, i64 %minus_index");
+        buffer.emit("    store i8 45, i8* %minus_slot");
+        buffer.emit("    br label %emit");
+        buffer.emit("emit:");
+        buffer.emit("    %first = phi i64 [ %index, %sign ], [ %minus_index, %minus ]");
+        buffer.emit("    %start = getelementptr [11 x i8], [11 x i8]* %digits, i64 0, i64 %first");
+        buffer.emit("    %count = sub i64 11, %first");
+        buffer.emit("    call void @.line(i8* %start, i64 %count)");
+        buffer.emit("    ret void");
+        buffer.emit("}");
+    }
+
+    // The length of a literal is known at compile time and passed along
+    if (use.print) {
+        buffer.emit("define void @print(i8*, i32) {");
+        buffer.emit("entry:");
+        buffer.emit("    %length = zext i32 %1 to i64");
+        buffer.emit("    call void @.line(i8* %0, i64 %length)");
+        buffer.emit("    ret void");
+        buffer.emit("}");
+    }
+
+    if (!use.division) return;
+    buffer.emit("declare void @exit(i32)");
+    buffer.emit("@.str_div_err = constant [23 x i8] c\"Error division by zero\\00\"");
+    buffer.emit("define void @.division_error() {");
+    buffer.emit("entry:");
+    buffer.emit("    call void @.line(i8* getelementptr inbounds ([23 x i8], [23 x i8]* @.str_div_err, i32 0, i32 0), i64 22)");
+    buffer.emit("    call void @.flush()");
+    buffer.emit("    call void @exit(i32 0)");
+    buffer.emit("    unreachable");
+    buffer.emit("}");
+}
+
+
+// ***VISITOR IMPLEMENTATIONS***
+
+void CodeGenerator::visit(ast::Funcs &node) {
+    functions_table->clear();
+    // Modules are linked together, so their strings carry the module name
+    strings = std::make_shared<StringPool>("@.str." + (options.module.empty() ? "" : options.module + "."));
+
+    // Only what the program calls; a whole program has already lost the
+    // functions main does not reach
+    LibraryUse use = libraryUse(node);
+    if (options.statistics && options.module.empty()) {
+        options.statistics->add("unused library functions",
+                                !use.print + !use.printi + !use.division);
+    }
+
+    if (options.module.empty() && !options.external_runtime) {
+        emitRuntime(buffer, use);
+    } else {
+        // Defined once by the link step or by the native runtime
+        if (use.division) buffer.emit("declare void @.division_error()");
+        if (use.printi) buffer.emit("declare void @printi(i32)");
+        if (use.print) buffer.emit("declare void @print(i8*, i32)");
+        for (const auto& module : options.imports) {
+            for (const auto& function : module.functions) {
+                if (functions_table->count(function.name)) continue;
+                std::string arguments;
+                for (size_t i = 0; i < function.arguments.size(); ++i) {
+                    arguments += i == 0 ? "i32" : ", i32";
+                }
+                buffer.emit("declare " + toLLVMType(function.return_type) + " @" + function.name + "(" + arguments + ")");
+                (*functions_table)[function.name] = function.return_type;
+            }
+        }
+    }
+
     //Register all function signatures to support forward references
     for (auto& func : node.funcs) {
-        functions_table[func->id->value] = func->return_type->type;
+        (*functions_table)[func->id->value] = func->return_type->type;
     }
 
-    //Generate code for function bodies
-    for (auto& func : node.funcs) {
-        func->accept(*this);
+    purity = std::make_shared<const Purity>(analyzePurity(node, options.memoize));
+    if (options.statistics) {
+        unsigned long readnone = 0;
+        for (const auto& effects : purity->effects) {
+            if (effects.second.pure()) ++readnone;
+        }
+        if (options.optimize) options.statistics->add("readnone functions", readnone);
+        if (options.memoize) options.statistics->add("memoized functions", purity->memoized.size());
+    }
+
+    // Small functions are inlined only into optimized code
+    unsigned threshold = options.optimize ? options.inline_threshold : 0;
+    inline_candidates = std::make_shared<const std::unordered_map<std::string, InlineCandidate>>(
+        threshold > 0 ? inlineCandidates(node, threshold) : std::unordered_map<std::string, InlineCandidate>());
+
+    //Lay out the string pool up front so the bodies never touch shared state
+    std::vector<std::pair<const ast::String*, std::string>> literals;
+    StringLiteralCollector collector(literals);
+    node.accept(collector);
+    for (const auto& literal : literals) {
+        strings->add(literal.second);
+    }
+    strings->finish();
+    if (options.statistics) {
+        options.statistics->add("duplicate string literals", strings->duplicates());
+        options.statistics->add("merged string suffixes", strings->merged());
+    }
+
+    // The code of a function holds the copies of its inlined callees, so its
+    // key holds their keys, computed callees first
+    auto keys = std::make_shared<std::unordered_map<std::string, std::string>>();
+    inline_keys = keys;
+    if (options.cache || options.incremental) {
+        for (bool progress = true; progress;) {
+            progress = false;
+            for (const auto& candidate : *inline_candidates) {
+                if (keys->count(candidate.first)) continue;
+                bool ready = true;
+                for (const auto& callee : candidate.second.callees) {
+                    if (inline_candidates->count(callee) && !keys->count(callee)) ready = false;
+                }
+                if (!ready) continue;
+                (*keys)[candidate.first] = functionKey(*candidate.second.func);
+                progress = true;
+            }
+        }
+    }
+
+    //Generate code for function bodies, each into its own buffer
+    std::vector<output::CodeBuffer> bodies(node.funcs.size());
+    std::vector<std::unique_ptr<output::CompileError>> errors(node.funcs.size());
+    ThreadPool pool(std::min<size_t>(ThreadPool::defaultThreads(options.jobs), node.funcs.size()));
+    for (size_t i = 0; i < node.funcs.size(); ++i) {
+        pool.submit([this, &node, &bodies, &errors, i] {
+            // Reported after the other functions, as the first error in source order
+            try {
+                const std::string& name = node.funcs[i]->id->value;
+                std::string key;
+                if (options.cache || options.incremental) {
+                    key = functionKey(*node.funcs[i]);
+                    std::string code;
+                    if ((options.incremental && options.incremental->lookup(name, key, code)) ||
+                        (options.cache && options.cache->lookup("function", key, code))) {
+                        bodies[i] << code;
+                        if (options.incremental) options.incremental->recordCode(name, key, code);
+                        return;
+                    }
+                }
+
+                CodeGenerator function_generator(bodies[i], *this);
+                node.funcs[i]->accept(function_generator);
+                if (options.optimize) {
+                    std::string optimized = propagateConstants(bodies[i].str(), options.statistics.get());
+                    optimized = optimizePeephole(optimized, options.statistics.get());
+                    optimized = hoistInvariants(optimized, options.statistics.get());
+                    // Closed forms of loops and unrolled copies often fold further
+                    std::string reduced = reduceInductions(optimized, options.statistics.get());
+                    reduced = unrollLoops(reduced, options.unroll, options.statistics.get());
+                    if (reduced != optimized) {
+                        optimized = propagateConstants(reduced, options.statistics.get());
+                        optimized = optimizePeephole(optimized, options.statistics.get());
+                    }
+                    optimized = numberValues(optimized, options.statistics.get());
+                    bodies[i] = output::CodeBuffer();
+                    bodies[i] << optimized;
+                }
+
+                if (options.cache) options.cache->store("function", key, bodies[i].str());
+                if (options.incremental) options.incremental->recordCode(name, key, bodies[i].str());
+            } catch (const std::exception &error) {
+                errors[i] = std::make_unique<output::CompileError>(output::internalError(error));
+            }
+        });
+    }
+    pool.wait();
+    for (const auto& error : errors) {
+        if (error) throw *error;
+    }
+
+    for (const auto& body : bodies) {
+        buffer.emitBuffer(body);
+    }
+
+    // Tables of the memoized functions, internal to the module like the strings
+    for (const auto& func : node.funcs) {
+        const std::string& name = func->id->value;
+        if (!purity->memoized.count(name)) continue;
+        std::string entries = "[" + std::to_string(memo_entries) + " x ";
+        buffer.emit(memoTable(name, "full") + " = internal global " + entries + "i1] zeroinitializer");
+        for (size_t i = 0; i < func->formals->formals.size(); ++i) {
+            buffer.emit(memoTable(name, "key" + std::to_string(i)) + " = internal global " + entries + "i32] zeroinitializer");
+        }
+        buffer.emit(memoTable(name, "value") + " = internal global " + entries + "i32] zeroinitializer");
     }
 
     // Emit global string literals
-    for (const auto& str : global_strings) {
-        buffer.emit(str.var_name + " = constant [" + std::to_string(str.length) + 
-                    " x i8] c\"" + str.value + "\\00\"");
+    strings->emit(buffer);
+}
+
+std::string CodeGenerator::functionKey(ast::FuncDecl& func) const {
+    Fingerprint fingerprint;
+    fingerprint.add(fanc::version());
+    fingerprint.add(options.optimize ? 1 : 0);
+    fingerprint.add(options.unroll);
+    fingerprint.add(options.inline_threshold);
+
+    FingerprintVisitor visitor(fingerprint);
+    func.accept(visitor);
+
+    // Return types of the functions it refers to, and the code of those it may inline
+    for (const auto& name : visitor.names) {
+        auto function = functions_table->find(name);
+        if (function != functions_table->end()) {
+            fingerprint.add(name);
+            fingerprint.add(function->second);
+        }
+        auto inlined = inline_keys->find(name);
+        if (inlined != inline_keys->end()) fingerprint.add(inlined->second);
+    }
+
+    // Whether it is readnone or memoized, which depends on its callees as well
+    const std::string& name = func.id->value;
+    auto effects = purity->effects.find(name);
+    fingerprint.add(effects != purity->effects.end() && effects->second.pure() ? 1 : 0);
+    fingerprint.add(purity->memoized.count(name) ? 1 : 0);
+
+    // Where the pool put its string literals
+    std::vector<std::pair<const ast::String*, std::string>> literals;
+    StringLiteralCollector collector(literals);
+    func.accept(collector);
+    for (const auto& literal : literals) {
+        const StringPool::Entry& entry = strings->entry(literal.second);
+        fingerprint.add(entry.global);
+        fingerprint.add(entry.global_length);
+        fingerprint.add(entry.offset);
     }
+
+    return fingerprint.hex();
 }
 
 void CodeGenerator::visit(ast::FuncDecl &node) {
@@ -122,47 +490,148 @@ void CodeGenerator::visit(ast::FuncDecl &node) {
     }
     
     std::string return_type_str = toLLVMType(node.return_type->type);
-    buffer.emit("define " + return_type_str + " @" + node.id->value + "(" + args_ss.str() + ") {");
+    // Without side effects, calls to it may be combined, moved or dropped
+    auto effects = purity->effects.find(node.id->value);
+    std::string attributes = options.optimize && effects != purity->effects.end() && effects->second.pure()
+                                 ? " readnone" : "";
+    buffer.emit("define " + return_type_str + " @" + node.id->value + "(" + args_ss.str() + ")" + attributes + " {");
     buffer.emitLabel("%entry");
+    entry_allocas.clear();
+    entry_position = buffer.size();
+    reachable = true;
 
     beginScope();
 
     // Allocate stack space for arguments and store initial values
+    function_name = node.id->value;
+    function_return_type = node.return_type->type;
+    parameters.clear();
     if (node.formals) {
         for (size_t i = 0; i < node.formals->formals.size(); ++i) {
             auto formal = node.formals->formals[i];
-            std::string ptr_reg = buffer.freshVar();
-            buffer.emit(ptr_reg + " = alloca i32");
+            std::string ptr_reg = allocate("i32");
             buffer.emit("store i32 %" + std::to_string(i) + ", i32* " + ptr_reg);
             declareVar(formal->id->value, ptr_reg, formal->type->type);
+            parameters.push_back(ptr_reg);
+        }
+    }
+
+    memo_index.clear();
+    if (purity->memoized.count(function_name)) emitMemoLookup();
+
+    // Self-recursive calls in tail position jump back to here; a memoized
+    // function fills its table with the result of every call instead
+    tail_recursion_label.clear();
+    if (options.optimize && memo_index.empty()) {
+        TailRecursionFinder finder(function_name);
+        node.body->accept(finder);
+        if (finder.found) {
+            tail_recursion_label = buffer.freshLabel();
+            buffer.emit("br label " + tail_recursion_label);
+            buffer.emitLabel(tail_recursion_label);
         }
     }
 
     node.body->accept(*this);
     endScope();
 
-    // Fallback return to ensure valid control flow
-    std::string fallback_label = buffer.freshLabel();
-    buffer.emit("br label " + fallback_label);
-    buffer.emitLabel(fallback_label);
-
-    if (node.return_type->type == ast::BuiltInType::VOID) {
-        buffer.emit("ret void");
-    } else {
-        buffer.emit("ret i32 0"); 
+    // Falling off the end of the body returns a default value
+    if (reachable) {
+        if (node.return_type->type == ast::BuiltInType::VOID) {
+            buffer.emit("ret void");
+        } else {
+            emitReturn("0");
+        }
     }
 
+    buffer.insert(entry_position, entry_allocas);
     buffer.emit("}");
 }
 
+std::string CodeGenerator::allocate(const std::string& type) {
+    std::string ptr_reg = buffer.freshVar();
+    entry_allocas += ptr_reg + " = alloca " + type + "\n";
+    return ptr_reg;
+}
+
+void CodeGenerator::emitMemoLookup() {
+    // Fibonacci hashing: consecutive arguments land far apart
+    std::string hash = "%0";
+    for (size_t i = 1; i < parameters.size(); ++i) {
+        std::string scaled = buffer.freshVar();
+        buffer.emit(scaled + " = mul i32 " + hash + ", 31");
+        hash = buffer.freshVar();
+        buffer.emit(hash + " = add i32 " + scaled + ", %" + std::to_string(i));
+    }
+    std::string mixed = buffer.freshVar();
+    buffer.emit(mixed + " = mul i32 " + hash + ", -1640531535");
+    std::string entry = buffer.freshVar();
+    buffer.emit(entry + " = lshr i32 " + mixed + ", " + std::to_string(32 - memo_bits));
+    memo_index = buffer.freshVar();
+    buffer.emit(memo_index + " = zext i32 " + entry + " to i64");
+
+    auto element = [&](const std::string& part, const std::string& type) {
+        std::string pointer = memoEntry(buffer, function_name, part, type, memo_index);
+        std::string value = buffer.freshVar();
+        buffer.emit(value + " = load " + type + ", " + type + "* " + pointer);
+        return value;
+    };
+
+    std::string compare_label = buffer.freshLabel();
+    std::string hit_label = buffer.freshLabel();
+    std::string miss_label = buffer.freshLabel();
+    buffer.emit("br i1 " + element("full", "i1") + ", label " + compare_label + ", label " + miss_label);
+
+    buffer.emitLabel(compare_label);
+    std::string same;
+    for (size_t i = 0; i < parameters.size(); ++i) {
+        std::string equal = buffer.freshVar();
+        buffer.emit(equal + " = icmp eq i32 " + element("key" + std::to_string(i), "i32") + ", %" + std::to_string(i));
+        if (same.empty()) {
+            same = equal;
+        } else {
+            std::string both = buffer.freshVar();
+            buffer.emit(both + " = and i1 " + same + ", " + equal);
+            same = both;
+        }
+    }
+    buffer.emit("br i1 " + same + ", label " + hit_label + ", label " + miss_label);
+
+    buffer.emitLabel(hit_label);
+    buffer.emit("ret i32 " + element("value", "i32"));
+
+    buffer.emitLabel(miss_label);
+}
+
+void CodeGenerator::emitReturn(const std::string& value) {
+    if (!memo_index.empty()) {
+        auto store = [&](const std::string& part, const std::string& type, const std::string& stored) {
+            std::string pointer = memoEntry(buffer, function_name, part, type, memo_index);
+            buffer.emit("store " + type + " " + stored + ", " + type + "* " + pointer);
+        };
+        for (size_t i = 0; i < parameters.size(); ++i) {
+            store("key" + std::to_string(i), "i32", "%" + std::to_string(i));
+        }
+        store("value", "i32", value);
+        store("full", "i1", "true");
+    }
+    buffer.emit("ret i32 " + value);
+}
+
 void CodeGenerator::visit(ast::Call &node) {
     std::string func_name = node.func_id->value;
+    // Only the outermost call of a return is in tail position
+    bool tail = tail_call;
+    tail_call = false;
     
     // Built-in print function
     if (func_name == "print") {
         if (!node.args->exps.empty()) {
+            // print only takes literals, whose length the pool knows
             node.args->exps[0]->accept(*this);
-            buffer.emit("call void @print(i8* " + current_reg + ")");
+            auto literal = std::dynamic_pointer_cast<ast::String>(node.args->exps[0]);
+            int length = literal ? strings->entry(literal->value).length : 0;
+            buffer.emit("call void @print(i8* " + current_reg + ", i32 " + std::to_string(length) + ")");
         }
         return;
     } 
@@ -182,31 +651,28 @@ void CodeGenerator::visit(ast::Call &node) {
     }
 
     // User-defined functions
+    std::vector<std::string> args = arguments(node);
     std::stringstream args_str;
-    if (node.args) {
-        for (size_t i = 0; i < node.args->exps.size(); ++i) {
-            node.args->exps[i]->accept(*this);
-            
-            std::string arg_val = current_reg;
-            if (current_type == ast::BuiltInType::BOOL) {
-                std::string zext_reg = buffer.freshVar();
-                buffer.emit(zext_reg + " = zext i1 " + current_reg + " to i32");
-                arg_val = zext_reg;
-            }
-            
-            args_str << "i32 " << arg_val;
-            if (i < node.args->exps.size() - 1) {
-                args_str << ", ";
-            }
+    for (size_t i = 0; i < args.size(); ++i) {
+        args_str << "i32 " << args[i];
+        if (i < args.size() - 1) {
+            args_str << ", ";
         }
     }
+
+    auto candidate = inline_candidates->find(func_name);
+    if (candidate != inline_candidates->end() && worthInlining(candidate->second, node, options.inline_threshold)) {
+        inlineCall(node, candidate->second, args);
+        return;
+    }
     
     // Determine the return type logic
     bool is_void = false;
     bool is_bool = false; 
 
-    if (functions_table.find(func_name) != functions_table.end()) {
-        ast::BuiltInType ret_type = functions_table[func_name];
+    auto function = functions_table->find(func_name);
+    if (function != functions_table->end()) {
+        ast::BuiltInType ret_type = function->second;
         if (ret_type == ast::BuiltInType::VOID) {
             is_void = true;
         } else if (ret_type == ast::BuiltInType::BOOL) {
@@ -214,15 +680,28 @@ void CodeGenerator::visit(ast::Call &node) {
         }
     }
 
+    // A tail call lets LLVM reuse the caller's frame; FanC never passes the
+    // address of a local, so nothing the callee reads lives in that frame.
+    // With the caller's own prototype the reuse is guaranteed (musttail).
+    std::string call = "call ";
+    if (tail) {
+        bool same = function != functions_table->end() && args.size() == parameters.size() &&
+                    toLLVMType(function->second) == toLLVMType(function_return_type);
+        call = same ? "musttail call " : "tail call ";
+        if (options.statistics) options.statistics->add("tail calls");
+    }
+
     if (is_void) {
-        buffer.emit("call void @" + func_name + "(" + args_str.str() + ")");
+        buffer.emit(call + "void @" + func_name + "(" + args_str.str() + ")");
         current_reg = "0";
         current_type = ast::BuiltInType::VOID;
     } else {
         std::string res_reg = buffer.freshVar();
-        buffer.emit(res_reg + " = call i32 @" + func_name + "(" + args_str.str() + ")");
+        buffer.emit(res_reg + " = " + call + "i32 @" + func_name + "(" + args_str.str() + ")");
         
-        if (is_bool) {
+        // A function returning a bool returns 0 or 1, so the return around a
+        // tail call needs no conversion, which would keep the call from being one
+        if (is_bool && !tail) {
             std::string trunc_reg = buffer.freshVar();
             buffer.emit(trunc_reg + " = trunc i32 " + res_reg + " to i1");
             current_reg = trunc_reg;
@@ -234,10 +713,90 @@ void CodeGenerator::visit(ast::Call &node) {
     }
 }
 
+std::vector<std::string> CodeGenerator::arguments(ast::Call& node) {
+    std::vector<std::string> args;
+    if (!node.args) return args;
+    for (const auto& exp : node.args->exps) {
+        exp->accept(*this);
+        std::string arg_val = current_reg;
+        if (current_type == ast::BuiltInType::BOOL) {
+            std::string zext_reg = buffer.freshVar();
+            buffer.emit(zext_reg + " = zext i1 " + current_reg + " to i32");
+            arg_val = zext_reg;
+        }
+        args.push_back(arg_val);
+    }
+    return args;
+}
+
+void CodeGenerator::inlineCall(ast::Call& node, const InlineCandidate& callee, const std::vector<std::string>& args) {
+    ast::FuncDecl& func = *callee.func;
+    ast::BuiltInType return_type = func.return_type->type;
+
+    // The callee sees its own variables and loops only
+    std::vector<std::unordered_map<std::string, SymbolInfo>> caller_symbols;
+    std::vector<LoopLabels> caller_loops;
+    caller_symbols.swap(symbol_table);
+    caller_loops.swap(loops_stack);
+    beginScope();
+
+    // Falling off the end of the body returns a default value
+    InlinedCall call;
+    call.join_label = buffer.freshLabel();
+    if (return_type != ast::BuiltInType::VOID) {
+        call.result_ptr = allocate("i32");
+        buffer.emit("store i32 0, i32* " + call.result_ptr);
+    }
+    if (func.formals) {
+        for (size_t i = 0; i < func.formals->formals.size() && i < args.size(); ++i) {
+            auto formal = func.formals->formals[i];
+            std::string ptr_reg = allocate("i32");
+            buffer.emit("store i32 " + args[i] + ", i32* " + ptr_reg);
+            declareVar(formal->id->value, ptr_reg, formal->type->type);
+        }
+    }
+
+    inlined_calls.push_back(call);
+    func.body->accept(*this);
+    call = inlined_calls.back();
+    inlined_calls.pop_back();
+
+    endScope();
+    symbol_table.swap(caller_symbols);
+    loops_stack.swap(caller_loops);
+
+    // The expression around the call goes on in the join block, which stays
+    // even when the body never returns; the peephole pass drops it then
+    if (reachable) buffer.emit("br label " + call.join_label);
+    reachable = true;
+    buffer.emitLabel(call.join_label);
+    if (options.statistics) options.statistics->add("inlined calls");
+
+    if (return_type == ast::BuiltInType::VOID) {
+        current_reg = "0";
+        current_type = ast::BuiltInType::VOID;
+        return;
+    }
+    std::string res_reg = buffer.freshVar();
+    buffer.emit(res_reg + " = load i32, i32* " + call.result_ptr);
+    current_reg = res_reg;
+    current_type = ast::BuiltInType::INT;
+    if (return_type == ast::BuiltInType::BOOL) {
+        current_reg = buffer.freshVar();
+        buffer.emit(current_reg + " = trunc i32 " + res_reg + " to i1");
+        current_type = ast::BuiltInType::BOOL;
+    }
+}
+
 void CodeGenerator::visit(ast::Statements &node) {
     beginScope();
-    for (auto& st : node.statements) {
-        st->accept(*this);
+    for (size_t i = 0; i < node.statements.size(); ++i) {
+        // Nothing after a break, continue or return runs
+        if (!reachable) {
+            if (options.statistics) options.statistics->add("unreachable statements", node.statements.size() - i);
+            break;
+        }
+        node.statements[i]->accept(*this);
     }
     endScope();
 }
@@ -255,8 +814,7 @@ void CodeGenerator::visit(ast::VarDecl &node) {
         }
     }
 
-    std::string ptr_reg = buffer.freshVar();
-    buffer.emit(ptr_reg + " = alloca i32");
+    std::string ptr_reg = allocate("i32");
     buffer.emit("store i32 " + init_val + ", i32* " + ptr_reg);
 
     declareVar(node.id->value, ptr_reg, node.type->type);
@@ -304,70 +862,149 @@ void CodeGenerator::visit(ast::While &node) {
     std::string loop_label = buffer.freshLabel();
     std::string end_label = buffer.freshLabel();
 
+    // while (true) only ends through a break
+    auto literal = std::dynamic_pointer_cast<ast::Bool>(node.condition);
+    bool endless = literal && literal->value;
+
     loops_stack.push_back({check_label, end_label});
 
+    // Optimized loops are rotated: the condition guards the loop once and
+    // is tested again at the bottom, so an iteration takes one branch and
+    // the block before the body only runs when the loop is entered
+    if (options.optimize && !endless) {
+        node.condition->accept(*this);
+        buffer.emit("br i1 " + current_reg + ", label " + loop_label + ", label " + end_label);
+
+        buffer.emitLabel(loop_label);
+        node.body->accept(*this);
+        if (reachable) buffer.emit("br label " + check_label);
+        if (reachable || loops_stack.back().continued) {
+            buffer.emitLabel(check_label);
+            // Reached through the continues even when the body ends in one
+            reachable = true;
+            node.condition->accept(*this);
+            buffer.emit("br i1 " + current_reg + ", label " + loop_label + ", label " + end_label);
+        }
+
+        reachable = true;
+        buffer.emitLabel(end_label);
+        loops_stack.pop_back();
+        if (options.statistics) options.statistics->add("rotated loops");
+        return;
+    }
+
     buffer.emit("br label " + check_label);
     buffer.emitLabel(check_label);
-    
-    node.condition->accept(*this);
-    buffer.emit("br i1 " + current_reg + ", label " + loop_label + ", label " + end_label);
+
+    if (endless) {
+        buffer.emit("br label " + loop_label);
+    } else {
+        node.condition->accept(*this);
+        buffer.emit("br i1 " + current_reg + ", label " + loop_label + ", label " + end_label);
+    }
 
     buffer.emitLabel(loop_label);
     node.body->accept(*this);
-    buffer.emit("br label " + check_label);
+    if (reachable) buffer.emit("br label " + check_label);
+
+    reachable = !endless || loops_stack.back().exited;
+    if (reachable) buffer.emitLabel(end_label);
 
-    buffer.emitLabel(end_label);
-    
     loops_stack.pop_back();
 }
 
 void CodeGenerator::visit(ast::Break &node) {
     if (!loops_stack.empty()) {
         buffer.emit("br label " + loops_stack.back().end_label);
-        std::string unreachable = buffer.freshLabel();
-        buffer.emitLabel(unreachable);
+        loops_stack.back().exited = true;
+        reachable = false;
     }
 }
 
 void CodeGenerator::visit(ast::Continue &node) {
     if (!loops_stack.empty()) {
         buffer.emit("br label " + loops_stack.back().check_label);
-        std::string unreachable = buffer.freshLabel();
-        buffer.emitLabel(unreachable);
+        loops_stack.back().continued = true;
+        reachable = false;
     }
 }
 
 void CodeGenerator::visit(ast::If &node) {
     std::string true_label = buffer.freshLabel();
-    std::string false_label = buffer.freshLabel();
+    std::string false_label = node.otherwise ? buffer.freshLabel() : "";
     std::string end_label = buffer.freshLabel();
 
     node.condition->accept(*this);
-    buffer.emit("br i1 " + current_reg + ", label " + true_label + ", label " + false_label);
+    buffer.emit("br i1 " + current_reg + ", label " + true_label + ", label " +
+                (node.otherwise ? false_label : end_label));
 
+    // The end is reached when a branch falls through, or directly without an else
     buffer.emitLabel(true_label);
     node.then->accept(*this);
-    buffer.emit("br label " + end_label);
+    bool ends = !node.otherwise;
+    if (reachable) {
+        buffer.emit("br label " + end_label);
+        ends = true;
+    }
 
-    buffer.emitLabel(false_label);
     if (node.otherwise) {
+        buffer.emitLabel(false_label);
+        reachable = true;
         node.otherwise->accept(*this);
+        if (reachable) {
+            buffer.emit("br label " + end_label);
+            ends = true;
+        }
     }
-    buffer.emit("br label " + end_label);
 
-    buffer.emitLabel(end_label);
+    reachable = ends;
+    if (reachable) buffer.emitLabel(end_label);
 }
 
 void CodeGenerator::visit(ast::Return &node) {
+    auto call = std::dynamic_pointer_cast<ast::Call>(node.exp);
+    if (call && inlined_calls.empty()) {
+        // The function calling itself: the arguments become its parameters
+        // and it starts over, in the same frame
+        if (!tail_recursion_label.empty() && call->func_id->value == function_name) {
+            std::vector<std::string> args = arguments(*call);
+            for (size_t i = 0; i < args.size() && i < parameters.size(); ++i) {
+                buffer.emit("store i32 " + args[i] + ", i32* " + parameters[i]);
+            }
+            buffer.emit("br label " + tail_recursion_label);
+            reachable = false;
+            if (options.statistics) options.statistics->add("tail recursive calls");
+            return;
+        }
+        // The table of a memoized function is filled after the call returns
+        tail_call = options.optimize && memo_index.empty();
+    }
+
+    std::string ret_val;
     if (node.exp) {
         node.exp->accept(*this);
-        std::string ret_val = current_reg;
+        ret_val = current_reg;
         if (current_type == ast::BuiltInType::BOOL) {
             std::string zext_reg = buffer.freshVar();
             buffer.emit(zext_reg + " = zext i1 " + current_reg + " to i32");
             ret_val = zext_reg;
         }
-        buffer.emit("ret i32 " + ret_val);
+    }
+    reachable = false;
+
+    // Out of an inlined body: the result goes to its slot, control to the join block
+    if (!inlined_calls.empty()) {
+        InlinedCall& call = inlined_calls.back();
+        if (!call.result_ptr.empty() && !ret_val.empty()) {
+            buffer.emit("store i32 " + ret_val + ", i32* " + call.result_ptr);
+        }
+        buffer.emit("br label " + call.join_label);
+        call.returned = true;
+        return;
+    }
+
+    if (node.exp) {
+        emitReturn(ret_val);
     } else {
         buffer.emit("ret void");
     }
@@ -386,11 +1023,7 @@ void CodeGenerator::visit(ast::NumB &node) {
 }
 
 void CodeGenerator::visit(ast::String &node) {
-    std::string var_name = "@.str." + std::to_string(global_strings.size());
-    int length = node.value.length() + 1;
-    global_strings.push_back({node.value, var_name, length});
-    current_reg = "getelementptr inbounds ([" + std::to_string(length) + " x i8], [" + 
-                  std::to_string(length) + " x i8]* " + var_name + ", i32 0, i32 0)";
+    current_reg = strings->pointer(node.value);
     current_type = ast::BuiltInType::STRING;
 }
 
@@ -474,9 +1107,8 @@ void CodeGenerator::visit(ast::And &node) {
 
     std::string label_check_right = buffer.freshLabel();
     std::string label_end = buffer.freshLabel();
-    std::string ptr_var = buffer.freshVar(); 
+    std::string ptr_var = allocate("i1");
 
-    buffer.emit(ptr_var + " = alloca i1");
     buffer.emit("store i1 " + left_reg + ", i1* " + ptr_var);
     buffer.emit("br i1 " + left_reg + ", label " + label_check_right + ", label " + label_end);
 
@@ -499,9 +1131,8 @@ void CodeGenerator::visit(ast::Or &node) {
 
     std::string label_check_right = buffer.freshLabel();
     std::string label_end = buffer.freshLabel();
-    std::string ptr_var = buffer.freshVar();
+    std::string ptr_var = allocate("i1");
 
-    buffer.emit(ptr_var + " = alloca i1");
     buffer.emit("store i1 " + left_reg + ", i1* " + ptr_var);
     buffer.emit("br i1 " + left_reg + ", label " + label_end + ", label " + label_check_right);
 
@@ -4,6 +4,12 @@
 #include "nodes.hpp"
 #include "visitor.hpp"
 #include "output.hpp"
+#include "fanc.hpp"
+#include "reachability.hpp"
+#include "string_pool.hpp"
+#include "inliner.hpp"
+#include "purity.hpp"
+#include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -12,11 +18,28 @@
    This class traverses the Abstract Syntax Tree (AST) and emits corresponding 
    LLVM intermediate representation commands to the provided CodeBuffer.
    It manages symbol tables for variables and functions, as well as control flow 
-   structures for loops.*/
+   structures for loops.
+   Function bodies are independent once all signatures are known, so every
+   FuncDecl is generated by its own CodeGenerator into its own CodeBuffer on a
+   thread pool, and the buffers are concatenated in source order. The result
+   does not depend on the number of jobs. With a cache or an incremental
+   state, the code of a function is reused whenever its body, the signatures
+   it refers to and the places of its string literals are unchanged.
+   Optimized functions without side effects are declared readnone; with
+   options.memoize, pure recursive functions look their arguments up in a
+   direct-mapped table of earlier results before running the body, and every
+   return of theirs fills the entry (see purity.hpp).*/
 
 class CodeGenerator : public Visitor {
 public:
-    explicit CodeGenerator(output::CodeBuffer& buffer);
+    // options.jobs threads generate the function bodies; options.cache and
+    // options.incremental provide the code of unchanged functions
+    explicit CodeGenerator(output::CodeBuffer& buffer, const fanc::Options& options = fanc::Options());
+
+    // Emits the library programs are generated against: the buffered print
+    // and printi functions, the flush and the division by zero error. Only
+    // the parts in use are emitted, all of them by default.
+    static void emitRuntime(output::CodeBuffer& buffer, const LibraryUse& use = LibraryUse::all());
 
     // Visitor implementations for AST nodes
     virtual void visit(ast::Num& node) override;
@@ -48,6 +71,7 @@ public:
 
 private:
     output::CodeBuffer& buffer;
+    fanc::Options options;
     
     // Tracks the register holding the result of the last visited expression
     std::string current_reg;
@@ -68,7 +92,8 @@ private:
     std::vector<std::unordered_map<std::string, SymbolInfo>> symbol_table;
 
     // Maps function names to their return types to allow forward references.
-    std::unordered_map<std::string, ast::BuiltInType> functions_table;
+    // Shared read-only with the per-function generators.
+    std::shared_ptr<std::unordered_map<std::string, ast::BuiltInType>> functions_table;
 
     
     //Stores labels for control flow within loops.
@@ -77,18 +102,83 @@ private:
         std::string check_label;
         // (used by 'break')
         std::string end_label;   
+        // A break jumps to end_label
+        bool exited = false;
+        // A continue jumps to check_label
+        bool continued = false;
     };
 
     // Stack of active loops to handle nested 'break' and 'continue' statements.
     std::vector<LoopLabels> loops_stack;
 
-    // Represents a string literal to be defined globally.    
-    struct GlobalString {
-        std::string value;
-        std::string var_name;
-        int length;
+    // Whether control can reach the code emitted next. Cleared by break,
+    // continue and return; statements are not generated while it is false,
+    // and labels no branch refers to are never emitted.
+    bool reachable = true;
+
+    // String literals of the program, laid out before the bodies are
+    // generated and shared read-only with the per-function generators.
+    std::shared_ptr<StringPool> strings;
+
+    // Functions calls may be replaced by the body of (see inliner.hpp), found
+    // before the bodies are generated and shared read-only like the strings
+    std::shared_ptr<const std::unordered_map<std::string, InlineCandidate>> inline_candidates;
+    // Cache keys of the candidates, which are part of the keys of their callers
+    std::shared_ptr<const std::unordered_map<std::string, std::string>> inline_keys;
+
+    // Where the returns of the inlined bodies being generated go, innermost last
+    struct InlinedCall {
+        // Slot of the result, empty for a void function
+        std::string result_ptr;
+        std::string join_label;
+        // A return jumps to join_label
+        bool returned = false;
     };
-    std::vector<GlobalString> global_strings;
+    std::vector<InlinedCall> inlined_calls;
+
+    // What the functions of the program do (see purity.hpp), found before the
+    // bodies are generated and shared read-only like the strings
+    std::shared_ptr<const Purity> purity;
+    // Entry of the table of the memoized function being generated, empty for others
+    std::string memo_index;
+
+    // The function being generated: its name and type, the slots of its parameters and,
+    // when it returns calls to itself, the label such a call jumps back to
+    std::string function_name;
+    ast::BuiltInType function_return_type = ast::BuiltInType::VOID;
+    std::vector<std::string> parameters;
+    std::string tail_recursion_label;
+    // Set by a return whose value is a call, for that call only
+    bool tail_call = false;
+
+    // The allocas of the function, which all go to its entry block so that a
+    // variable declared in a loop or a call inlined into one does not grow
+    // the stack every iteration; entry_position is where they are inserted
+    std::string entry_allocas;
+    size_t entry_position = 0;
+
+    // A new slot of the given type in the entry block; the caller stores to it
+    // where the variable begins, so it starts over wherever it is declared
+    std::string allocate(const std::string& type);
+
+    // Evaluates the arguments of a call, bools extended to i32
+    std::vector<std::string> arguments(ast::Call& node);
+
+    // Looks the arguments of the memoized function up in its table, returning
+    // the stored result when they are found; sets memo_index
+    void emitMemoLookup();
+
+    // Returns value from the function, filling the table of a memoized one first
+    void emitReturn(const std::string& value);
+
+    // Generates the body of the callee in place of the call, the result in current_reg
+    void inlineCall(ast::Call& node, const InlineCandidate& callee, const std::vector<std::string>& args);
+
+    // Generator for a single function body that shares the tables of its parent
+    CodeGenerator(output::CodeBuffer& buffer, const CodeGenerator& parent);
+
+    // Cache key of the code generated for a function
+    std::string functionKey(ast::FuncDecl& func) const;
 
     // Helper methods
     void beginScope();
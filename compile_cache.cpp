@@ -0,0 +1,115 @@
+#include "compile_cache.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+CompileCache::CompileCache(const std::string &directory, uintmax_t max_bytes)
+    : directory(directory), max_bytes(max_bytes), total_bytes(0), clock(0), evictions(0) {
+    std::error_code error;
+    fs::create_directories(directory, error);
+
+    // Rebuild the recency order from the modification times
+    std::vector<std::pair<fs::file_time_type, std::string>> existing;
+    for (const auto &file : fs::directory_iterator(directory, error)) {
+        if (!file.is_regular_file()) continue;
+        std::string name = file.path().filename().string();
+        if (name.find(".tmp") != std::string::npos) continue;
+        existing.push_back({file.last_write_time(), name});
+        entries[name] = {file.file_size(), 0};
+        total_bytes += file.file_size();
+    }
+    std::sort(existing.begin(), existing.end());
+    for (const auto &file : existing) {
+        entries[file.second].last_use = ++clock;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    evict();
+}
+
+bool CompileCache::lookup(const std::string &kind, const std::string &key, std::string &value) {
+    std::string name = kind + "-" + key;
+    fs::path path = fs::path(directory) / name;
+
+    std::ifstream in(path, std::ios::binary);
+    std::lock_guard<std::mutex> guard(lock);
+    if (!in) {
+        ++counters[kind].misses;
+        return false;
+    }
+    std::stringstream content;
+    content << in.rdbuf();
+    value = content.str();
+    ++counters[kind].hits;
+
+    std::error_code error;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), error);
+    auto entry = entries.find(name);
+    if (entry == entries.end()) {
+        // Written by another process
+        entries[name] = {value.size(), ++clock};
+        total_bytes += value.size();
+        evict();
+    } else {
+        entry->second.last_use = ++clock;
+    }
+    return true;
+}
+
+void CompileCache::store(const std::string &kind, const std::string &key, const std::string &value) {
+    // Would only flush everything else out
+    if (value.size() > max_bytes) return;
+
+    std::string name = kind + "-" + key;
+    fs::path path = fs::path(directory) / name;
+
+    // Write to a private file first so readers never see a partial entry
+    std::ostringstream temporary_name;
+    temporary_name << name << ".tmp." << std::this_thread::get_id();
+    fs::path temporary = fs::path(directory) / temporary_name.str();
+    {
+        std::ofstream out(temporary, std::ios::binary);
+        out << value;
+        if (!out) return;
+    }
+    std::error_code error;
+    fs::rename(temporary, path, error);
+    if (error) {
+        fs::remove(temporary, error);
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    auto entry = entries.find(name);
+    if (entry != entries.end()) total_bytes -= entry->second.size;
+    entries[name] = {value.size(), ++clock};
+    total_bytes += value.size();
+    evict();
+}
+
+void CompileCache::evict() {
+    while (total_bytes > max_bytes && !entries.empty()) {
+        auto oldest = std::min_element(entries.begin(), entries.end(), [](const auto &a, const auto &b) {
+            return a.second.last_use < b.second.last_use;
+        });
+        std::error_code error;
+        fs::remove(fs::path(directory) / oldest->first, error);
+        total_bytes -= oldest->second.size;
+        entries.erase(oldest);
+        ++evictions;
+    }
+}
+
+void CompileCache::report(std::ostream &os) const {
+    std::lock_guard<std::mutex> guard(lock);
+    os << "cache:";
+    for (const auto &counter : counters) {
+        os << " " << counter.first << " " << counter.second.hits << " hits / " << counter.second.misses << " misses,";
+    }
+    os << " " << evictions << " evicted, " << entries.size() << " entries, " << total_bytes << " bytes" << std::endl;
+}
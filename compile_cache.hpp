@@ -0,0 +1,55 @@
+#ifndef COMPILE_CACHE_HPP
+#define COMPILE_CACHE_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/* On-disk cache of compilation results.
+   Entries live in one directory as files named <kind>-<key>; kind separates
+   independent key spaces (whole programs, single functions). When the total
+   size of the entries exceeds the bound, the least recently used entries are
+   removed. Recency survives restarts through the file modification times.
+   The object is safe to share between threads; several processes may use the
+   same directory, entries are written atomically. */
+class CompileCache {
+public:
+    CompileCache(const std::string &directory, uintmax_t max_bytes);
+
+    // Returns true and fills value if the entry exists
+    bool lookup(const std::string &kind, const std::string &key, std::string &value);
+
+    void store(const std::string &kind, const std::string &key, const std::string &value);
+
+    // Writes the hit/miss counters of every kind and the cache occupancy
+    void report(std::ostream &os) const;
+
+private:
+    struct Entry {
+        uintmax_t size;
+        uint64_t last_use;
+    };
+
+    struct Counters {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    std::string directory;
+    uintmax_t max_bytes;
+
+    mutable std::mutex lock;
+    // File name -> entry
+    std::unordered_map<std::string, Entry> entries;
+    uintmax_t total_bytes;
+    uint64_t clock;
+    std::map<std::string, Counters> counters;
+    uint64_t evictions;
+
+    void evict();
+};
+
+#endif // COMPILE_CACHE_HPP
@@ -0,0 +1,237 @@
+#include "compile_server.hpp"
+#include "thread_pool.hpp"
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    const char REQUEST_COMPILE = 'C';
+    const char REQUEST_QUIT = 'Q';
+    const char RESPONSE_IR = 'O';
+    const char RESPONSE_ERROR = 'E';
+
+    // Largest request the server reads; a larger one is answered with an
+    // error and the connection closed, the length comes from the client
+    const uint32_t MAX_REQUEST = 64u << 20;
+    // A worker keeps the storage of requests up to this size for the next one
+    const size_t KEPT_REQUEST = 1u << 20;
+
+    enum class Frame { READ, CLOSED, TOO_LARGE };
+
+    bool readAll(int fd, char *data, size_t size) {
+        while (size > 0) {
+            ssize_t got = ::read(fd, data, size);
+            if (got <= 0) return false;
+            data += got;
+            size -= got;
+        }
+        return true;
+    }
+
+    bool writeAll(int fd, const char *data, size_t size) {
+        while (size > 0) {
+            // MSG_NOSIGNAL: a vanished client must not kill the server with SIGPIPE
+            ssize_t sent = ::send(fd, data, size, MSG_NOSIGNAL);
+            if (sent <= 0) return false;
+            data += sent;
+            size -= sent;
+        }
+        return true;
+    }
+
+    // Reads one frame of at most limit bytes into payload, reusing its storage
+    Frame readFrame(int fd, char &kind, std::string &payload, uint32_t limit = UINT32_MAX) {
+        unsigned char header[5];
+        if (!readAll(fd, reinterpret_cast<char *>(header), sizeof(header))) return Frame::CLOSED;
+        kind = static_cast<char>(header[0]);
+        uint32_t length = (uint32_t(header[1]) << 24) | (uint32_t(header[2]) << 16) |
+                          (uint32_t(header[3]) << 8) | uint32_t(header[4]);
+        if (length > limit) return Frame::TOO_LARGE;
+        payload.resize(length);
+        return length == 0 || readAll(fd, &payload[0], length) ? Frame::READ : Frame::CLOSED;
+    }
+
+    bool writeFrame(int fd, char kind, const std::string &payload) {
+        uint32_t length = static_cast<uint32_t>(payload.size());
+        unsigned char header[5] = {static_cast<unsigned char>(kind),
+                                   static_cast<unsigned char>(length >> 24), static_cast<unsigned char>(length >> 16),
+                                   static_cast<unsigned char>(length >> 8), static_cast<unsigned char>(length)};
+        return writeAll(fd, reinterpret_cast<const char *>(header), sizeof(header)) &&
+               writeAll(fd, payload.data(), payload.size());
+    }
+
+    int connectTo(const std::string &socket_path) {
+        sockaddr_un address{};
+        if (socket_path.size() >= sizeof(address.sun_path)) return -1;
+        address.sun_family = AF_UNIX;
+        std::strcpy(address.sun_path, socket_path.c_str());
+
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    /* Connections accepted but not yet picked up by a worker */
+    class ConnectionQueue {
+    public:
+        explicit ConnectionQueue(size_t capacity) : capacity(capacity == 0 ? 1 : capacity), closed(false) {}
+
+        // Blocks while the queue is full
+        void push(int fd) {
+            std::unique_lock<std::mutex> guard(lock);
+            not_full.wait(guard, [this] { return connections.size() < capacity; });
+            connections.push_back(fd);
+            not_empty.notify_one();
+        }
+
+        // Returns -1 once the queue is closed and drained
+        int pop() {
+            std::unique_lock<std::mutex> guard(lock);
+            not_empty.wait(guard, [this] { return closed || !connections.empty(); });
+            if (connections.empty()) return -1;
+            int fd = connections.front();
+            connections.pop_front();
+            not_full.notify_one();
+            return fd;
+        }
+
+        void close() {
+            std::lock_guard<std::mutex> guard(lock);
+            closed = true;
+            not_empty.notify_all();
+        }
+
+    private:
+        size_t capacity;
+        bool closed;
+        std::deque<int> connections;
+        std::mutex lock;
+        std::condition_variable not_empty;
+        std::condition_variable not_full;
+    };
+}
+
+int serveCompiler(const std::string &socket_path, unsigned workers, size_t backlog,
+                  const fanc::Options &options, std::ostream &log) {
+    sockaddr_un address{};
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        log << "serve: socket path too long: " << socket_path << std::endl;
+        return 1;
+    }
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, socket_path.c_str());
+
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ::unlink(socket_path.c_str());
+    if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 ||
+        ::chmod(socket_path.c_str(), S_IRUSR | S_IWUSR) < 0 || ::listen(listener, static_cast<int>(backlog)) < 0) {
+        log << "serve: cannot listen on " << socket_path << ": " << std::strerror(errno) << std::endl;
+        if (listener >= 0) ::close(listener);
+        return 1;
+    }
+
+    std::atomic<bool> stopping(false);
+    ConnectionQueue queue(backlog);
+
+    auto serveConnection = [&](int fd, std::string &request) {
+        char kind;
+        for (Frame frame; (frame = readFrame(fd, kind, request, MAX_REQUEST)) != Frame::CLOSED;) {
+            if (frame == Frame::TOO_LARGE) {
+                writeFrame(fd, RESPONSE_ERROR, "request larger than " + std::to_string(MAX_REQUEST) + " bytes\n");
+                break;
+            }
+            if (kind == REQUEST_QUIT) {
+                stopping = true;
+                writeFrame(fd, RESPONSE_IR, "");
+                // Wake the accept loop so it notices the request
+                int waker = connectTo(socket_path);
+                if (waker >= 0) ::close(waker);
+                break;
+            }
+            if (kind != REQUEST_COMPILE) break;
+
+            fanc::Result result = fanc::compile(request, options);
+            // One large request must not pin its memory to the worker
+            if (request.capacity() > KEPT_REQUEST) std::string().swap(request);
+            if (!writeFrame(fd, result.ok ? RESPONSE_IR : RESPONSE_ERROR, result.ok ? result.ir : result.diagnostics)) {
+                break;
+            }
+        }
+        if (request.capacity() > KEPT_REQUEST) std::string().swap(request);
+        ::close(fd);
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < ThreadPool::defaultThreads(workers); ++i) {
+        threads.emplace_back([&queue, &serveConnection] {
+            // Request buffer of this worker, its capacity is kept between
+            // requests up to KEPT_REQUEST bytes
+            std::string request;
+            for (int fd = queue.pop(); fd >= 0; fd = queue.pop()) {
+                serveConnection(fd, request);
+            }
+        });
+    }
+
+    log << "serve: listening on " << socket_path << " with " << threads.size() << " workers" << std::endl;
+    while (!stopping) {
+        int fd = ::accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (stopping) {
+            ::close(fd);
+            break;
+        }
+        queue.push(fd);
+    }
+
+    queue.close();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    ::close(listener);
+    ::unlink(socket_path.c_str());
+    return 0;
+}
+
+bool requestCompile(const std::string &socket_path, const std::string &source, fanc::Result &result) {
+    int fd = connectTo(socket_path);
+    if (fd < 0) return false;
+
+    char status;
+    std::string payload;
+    bool ok = writeFrame(fd, REQUEST_COMPILE, source) && readFrame(fd, status, payload) == Frame::READ;
+    ::close(fd);
+    if (!ok) return false;
+
+    result.ok = status == RESPONSE_IR;
+    (result.ok ? result.ir : result.diagnostics) = payload;
+    return true;
+}
+
+bool requestShutdown(const std::string &socket_path) {
+    int fd = connectTo(socket_path);
+    if (fd < 0) return false;
+
+    char status;
+    std::string payload;
+    bool ok = writeFrame(fd, REQUEST_QUIT, "") && readFrame(fd, status, payload) == Frame::READ;
+    ::close(fd);
+    return ok;
+}
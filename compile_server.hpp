@@ -0,0 +1,33 @@
+#ifndef COMPILE_SERVER_HPP
+#define COMPILE_SERVER_HPP
+
+#include <iostream>
+#include <string>
+#include "fanc.hpp"
+
+/* Compile server over a local UNIX socket.
+   A client sends framed requests on a connection and gets one framed
+   response per request:
+       request:  kind (1 byte) | length (4 bytes, big endian) | payload
+       response: status (1 byte) | length (4 bytes, big endian) | payload
+   Kinds: 'C' compiles the payload, 'Q' stops the server (empty payload,
+   what --connect SOCKET --stop sends). Any client may stop the server, so
+   the socket is made accessible to its owner only.
+   Status: 'O' the payload is LLVM IR, 'E' the payload is the diagnostic.
+   A request longer than 64 MiB is answered with 'E' and the connection
+   closed without reading it.
+   Connections are served by a fixed set of worker threads; at most
+   backlog accepted connections wait for a worker, further clients wait in
+   accept(). */
+
+// Runs the server until a 'Q' request arrives; returns the process exit code
+int serveCompiler(const std::string &socket_path, unsigned workers, size_t backlog,
+                  const fanc::Options &options, std::ostream &log);
+
+// Sends one source to a running server; returns false if the server could not be reached
+bool requestCompile(const std::string &socket_path, const std::string &source, fanc::Result &result);
+
+// Asks a running server to stop
+bool requestShutdown(const std::string &socket_path);
+
+#endif // COMPILE_SERVER_HPP
@@ -0,0 +1,430 @@
+#include "constant_propagation.hpp"
+#include "ir_text.hpp"
+#include "statistics.hpp"
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+using namespace ir;
+
+namespace {
+    // Not known yet, one constant, or possibly more than one value
+    struct Lattice {
+        enum Kind { UNDEFINED, CONSTANT, OVERDEFINED };
+        Kind kind = UNDEFINED;
+        long long value = 0;
+
+        static Lattice constant(long long value) { return {CONSTANT, value}; }
+        static Lattice overdefined() { return {OVERDEFINED, 0}; }
+
+        bool operator==(const Lattice &other) const { return kind == other.kind && value == other.value; }
+        bool operator!=(const Lattice &other) const { return !(*this == other); }
+    };
+
+    Lattice meet(const Lattice &a, const Lattice &b) {
+        if (a.kind == Lattice::UNDEFINED) return b;
+        if (b.kind == Lattice::UNDEFINED) return a;
+        if (a == b) return a;
+        return Lattice::overdefined();
+    }
+
+    // Width of an integer type, 0 for other types
+    int width(const std::string &type) {
+        if (type.size() < 2 || type[0] != 'i' || !isConstant(type.substr(1))) return 0;
+        int bits = std::stoi(type.substr(1));
+        return bits >= 1 && bits <= 64 ? bits : 0;
+    }
+
+    // Constants are kept signed in their width, i1 as 0 or 1
+    long long wrap(unsigned long long value, int bits) {
+        if (bits == 1) return static_cast<long long>(value & 1);
+        if (bits < 64) {
+            unsigned long long mask = (1ULL << bits) - 1;
+            value &= mask;
+            if (value >> (bits - 1)) value |= ~mask;
+        }
+        return static_cast<long long>(value);
+    }
+
+    unsigned long long unsignedValue(long long value, int bits) {
+        unsigned long long result = static_cast<unsigned long long>(value);
+        return bits < 64 ? result & ((1ULL << bits) - 1) : result;
+    }
+
+    long long signedValue(long long value, int bits) {
+        return bits == 1 ? -value : value;
+    }
+
+    Lattice fold(const std::string &op, int bits, long long a, long long b) {
+        unsigned long long x = static_cast<unsigned long long>(a), y = static_cast<unsigned long long>(b);
+        if (op == "add") return Lattice::constant(wrap(x + y, bits));
+        if (op == "sub") return Lattice::constant(wrap(x - y, bits));
+        if (op == "mul") return Lattice::constant(wrap(x * y, bits));
+        if (op == "and") return Lattice::constant(wrap(x & y, bits));
+        if (op == "or") return Lattice::constant(wrap(x | y, bits));
+        if (op == "xor") return Lattice::constant(wrap(x ^ y, bits));
+        if (op == "shl" || op == "lshr" || op == "ashr") {
+            // Shifting by the width or more is poison
+            if (b < 0 || b >= bits) return Lattice::overdefined();
+            if (op == "shl") return Lattice::constant(wrap(x << b, bits));
+            if (op == "lshr") return Lattice::constant(wrap(unsignedValue(a, bits) >> b, bits));
+            return Lattice::constant(wrap(static_cast<unsigned long long>(signedValue(a, bits) >> b), bits));
+        }
+        if (bits == 1) return Lattice::overdefined();
+        // Division by zero and the overflowing quotient are left to run
+        if (op == "sdiv" && b != 0 && !(b == -1 && a == wrap(1ULL << (bits - 1), bits))) {
+            return Lattice::constant(wrap(static_cast<unsigned long long>(a / b), bits));
+        }
+        if (op == "udiv" && unsignedValue(b, bits) != 0) {
+            return Lattice::constant(wrap(unsignedValue(a, bits) / unsignedValue(b, bits), bits));
+        }
+        return Lattice::overdefined();
+    }
+
+    Lattice compare(const std::string &predicate, int bits, long long a, long long b) {
+        long long sa = signedValue(a, bits), sb = signedValue(b, bits);
+        unsigned long long ua = unsignedValue(a, bits), ub = unsignedValue(b, bits);
+        bool result;
+        if (predicate == "eq") result = a == b;
+        else if (predicate == "ne") result = a != b;
+        else if (predicate == "slt") result = sa < sb;
+        else if (predicate == "sgt") result = sa > sb;
+        else if (predicate == "sle") result = sa <= sb;
+        else if (predicate == "sge") result = sa >= sb;
+        else if (predicate == "ult") result = ua < ub;
+        else if (predicate == "ugt") result = ua > ub;
+        else if (predicate == "ule") result = ua <= ub;
+        else if (predicate == "uge") result = ua >= ub;
+        else return Lattice::overdefined();
+        return Lattice::constant(result ? 1 : 0);
+    }
+
+    // Splits "a, b" at the first ", "
+    std::pair<std::string, std::string> operands(const std::string &text) {
+        size_t comma = text.find(", ");
+        if (comma == std::string::npos) return {text, ""};
+        return {text.substr(0, comma), text.substr(comma + 2)};
+    }
+
+    // The "[ value, %block ]" entries of a phi
+    std::vector<std::pair<std::string, std::string>> incoming(const std::string &phi) {
+        std::vector<std::pair<std::string, std::string>> result;
+        for (size_t open = phi.find("[ "); open != std::string::npos; open = phi.find("[ ", open + 2)) {
+            size_t close = phi.find(" ]", open);
+            if (close == std::string::npos) break;
+            auto entry = operands(phi.substr(open + 2, close - open - 2));
+            result.push_back({entry.first, entry.second.substr(1)});
+        }
+        return result;
+    }
+
+    class Propagation {
+    public:
+        explicit Propagation(const std::vector<std::string> &lines);
+
+        // Every block ends in a terminator; otherwise the blocks after one
+        // that does not would look unreachable
+        bool wellFormed() const;
+
+        // Evaluates the executable blocks until nothing changes
+        void solve();
+        std::vector<std::string> rewrite(unsigned long &constants, unsigned long &pruned, unsigned long &removed) const;
+
+    private:
+        // Value of every slot at a point of a block
+        using State = std::unordered_map<std::string, Lattice>;
+
+        struct Block {
+            std::string name;
+            size_t begin, end;  // instructions, without the label
+        };
+
+        Lattice operand(const std::string &value) const;
+        Lattice evaluate(const std::string &rest, size_t block, const State &state) const;
+        bool process(size_t block);
+        bool flow(size_t from, const std::string &target, const State &state);
+        bool taken(const std::string &from, size_t to) const;
+
+        const std::vector<std::string> &lines;
+        std::vector<Block> blocks;
+        std::unordered_map<std::string, size_t> index;
+        std::unordered_set<std::string> defined;
+        std::unordered_set<std::string> slots;
+
+        std::vector<bool> executable;
+        std::set<std::pair<size_t, size_t>> edges;
+        std::vector<State> in;
+        std::unordered_map<std::string, Lattice> values;
+    };
+
+    Propagation::Propagation(const std::vector<std::string> &lines) : lines(lines) {
+        for (size_t i = 0; i < lines.size(); ++i) {
+            const std::string &line = lines[i];
+            if (startsWith(line, "define ") || line == "}") continue;
+            if (isLabel(line)) {
+                std::string name = line.substr(0, line.size() - 1);
+                index[name] = blocks.size();
+                blocks.push_back({name, i + 1, i + 1});
+                continue;
+            }
+            // Instructions before any label belong to an unnamed entry block
+            if (blocks.empty()) blocks.push_back({"", i, i});
+            blocks.back().end = i + 1;
+
+            std::string name = definedName(line);
+            if (name.empty()) continue;
+            defined.insert(name);
+            if (startsWith(line.substr(name.size() + 3), "alloca ")) slots.insert(name);
+        }
+        executable.assign(blocks.size(), false);
+        in.assign(blocks.size(), State());
+        if (!blocks.empty()) executable[0] = true;
+    }
+
+    bool Propagation::wellFormed() const {
+        for (const auto &block : blocks) {
+            if (block.end == block.begin) return false;
+            const std::string &last = lines[block.end - 1];
+            if (!isTerminator(last) && !startsWith(last, "switch ")) return false;
+        }
+        return true;
+    }
+
+    Lattice Propagation::operand(const std::string &value) const {
+        if (isConstant(value)) return Lattice::constant(std::stoll(value));
+        if (value == "true") return Lattice::constant(1);
+        if (value == "false") return Lattice::constant(0);
+        auto found = values.find(value);
+        if (found != values.end()) return found->second;
+        // Defined in a block not evaluated yet, or an argument or global
+        return defined.count(value) ? Lattice() : Lattice::overdefined();
+    }
+
+    bool Propagation::taken(const std::string &from, size_t to) const {
+        auto found = index.find(from);
+        return found != index.end() && edges.count({found->second, to});
+    }
+
+    Lattice Propagation::evaluate(const std::string &rest, size_t block, const State &state) const {
+        size_t space = rest.find(' ');
+        std::string op = rest.substr(0, space);
+        std::string tail = space == std::string::npos ? "" : rest.substr(space + 1);
+
+        if (op == "load") {
+            // load <type>, <type>* <slot>
+            std::string slot = tail.substr(tail.rfind("* ") + 2);
+            if (!slots.count(slot)) return Lattice::overdefined();
+            auto found = state.find(slot);
+            return found == state.end() ? Lattice() : found->second;
+        }
+        if (op == "phi") {
+            Lattice result;
+            for (const auto &entry : incoming(tail)) {
+                if (taken(entry.second, block)) result = meet(result, operand(entry.first));
+            }
+            return result;
+        }
+
+        Lattice a, b;
+        std::string predicate;
+        int bits;
+        if (op == "icmp") {
+            // icmp <predicate> <type> <a>, <b>
+            size_t type_begin = tail.find(' ') + 1;
+            size_t type_end = tail.find(' ', type_begin);
+            predicate = tail.substr(0, type_begin - 1);
+            bits = width(tail.substr(type_begin, type_end - type_begin));
+            auto pair = operands(tail.substr(type_end + 1));
+            a = operand(pair.first);
+            b = operand(pair.second);
+        } else if (op == "zext" || op == "sext" || op == "trunc") {
+            // <cast> <type> <value> to <type>
+            size_t type_end = tail.find(' ');
+            size_t to = tail.find(" to ");
+            if (type_end == std::string::npos || to == std::string::npos) return Lattice::overdefined();
+            int from_bits = width(tail.substr(0, type_end));
+            bits = width(tail.substr(to + 4));
+            a = operand(tail.substr(type_end + 1, to - type_end - 1));
+            if (!from_bits || !bits || a.kind == Lattice::OVERDEFINED) return Lattice::overdefined();
+            if (a.kind == Lattice::UNDEFINED) return a;
+            unsigned long long value = op == "zext" ? unsignedValue(a.value, from_bits)
+                                                    : static_cast<unsigned long long>(signedValue(a.value, from_bits));
+            return Lattice::constant(wrap(value, bits));
+        } else if (op == "add" || op == "sub" || op == "mul" || op == "and" || op == "or" || op == "xor" ||
+                   op == "sdiv" || op == "udiv" || op == "shl" || op == "lshr" || op == "ashr") {
+            // <op> <type> <a>, <b>
+            size_t type_end = tail.find(' ');
+            if (type_end == std::string::npos) return Lattice::overdefined();
+            bits = width(tail.substr(0, type_end));
+            auto pair = operands(tail.substr(type_end + 1));
+            a = operand(pair.first);
+            b = operand(pair.second);
+        } else {
+            // Calls and whatever else is not followed
+            return Lattice::overdefined();
+        }
+
+        if (!bits || a.kind == Lattice::OVERDEFINED || b.kind == Lattice::OVERDEFINED) return Lattice::overdefined();
+        if (a.kind == Lattice::UNDEFINED || b.kind == Lattice::UNDEFINED) return Lattice();
+        return op == "icmp" ? compare(predicate, bits, a.value, b.value) : fold(op, bits, a.value, b.value);
+    }
+
+    bool Propagation::flow(size_t from, const std::string &target, const State &state) {
+        auto found = index.find(target);
+        if (found == index.end()) return false;
+        size_t to = found->second;
+        bool changed = edges.insert({from, to}).second;
+        if (!executable[to]) {
+            executable[to] = true;
+            changed = true;
+        }
+        for (const auto &slot : state) {
+            Lattice &into = in[to][slot.first];
+            Lattice merged = meet(into, slot.second);
+            if (merged != into) {
+                into = merged;
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    bool Propagation::process(size_t block) {
+        bool changed = false;
+        State state = in[block];
+        for (size_t i = blocks[block].begin; i < blocks[block].end; ++i) {
+            const std::string &line = lines[i];
+            std::string name = definedName(line);
+            if (!name.empty()) {
+                std::string rest = line.substr(name.size() + 3);
+                if (startsWith(rest, "alloca ")) {
+                    // A fresh slot holds nothing yet, also when a loop allocates it again
+                    state.erase(name);
+                }
+                // Values only move down the lattice, whatever order blocks are evaluated in
+                Lattice &value = values[name];
+                Lattice merged = meet(value, evaluate(rest, block, state));
+                if (merged != value) {
+                    value = merged;
+                    changed = true;
+                }
+            } else if (startsWith(line, "store ")) {
+                // store <type> <value>, <type>* <slot>
+                std::string slot = line.substr(line.rfind("* ") + 2);
+                if (!slots.count(slot)) continue;
+                size_t value = line.find(' ', 6) + 1;
+                size_t comma = line.find(", ", value);
+                state[slot] = operand(line.substr(value, comma - value));
+            } else if (startsWith(line, "br i1 ")) {
+                // br i1 <condition>, label %<true>, label %<false>
+                std::string condition = line.substr(6, line.find(", ") - 6);
+                Lattice value = operand(condition);
+                std::vector<std::string> both = labelOperands(line);
+                if (value.kind == Lattice::CONSTANT) {
+                    changed |= flow(block, both[value.value ? 0 : 1], state);
+                } else {
+                    // Not known to be constant: either way may be taken
+                    for (const auto &target : both) {
+                        changed |= flow(block, target, state);
+                    }
+                }
+            } else if (isTerminator(line) || startsWith(line, "switch ")) {
+                for (const auto &target : labelOperands(line)) {
+                    changed |= flow(block, target, state);
+                }
+            }
+        }
+        return changed;
+    }
+
+    void Propagation::solve() {
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (size_t block = 0; block < blocks.size(); ++block) {
+                if (executable[block]) changed |= process(block);
+            }
+        }
+    }
+
+    std::vector<std::string> Propagation::rewrite(unsigned long &constants, unsigned long &pruned,
+                                                  unsigned long &removed) const {
+        Substitution substitution;
+        for (const auto &value : values) {
+            if (value.second.kind == Lattice::CONSTANT) {
+                substitution.add(value.first, std::to_string(value.second.value));
+            }
+        }
+
+        std::vector<std::string> kept;
+        size_t next = 0;
+        for (size_t block = 0; block <= blocks.size(); ++block) {
+            // The lines before the block: "define" before the first, "}" after the last
+            size_t label = block < blocks.size() ? blocks[block].begin - (blocks[block].name.empty() ? 0 : 1)
+                                                 : lines.size();
+            for (; next < label; ++next) {
+                kept.push_back(lines[next]);
+            }
+            if (block == blocks.size()) break;
+            next = blocks[block].end;
+            if (!executable[block]) {
+                ++removed;
+                continue;
+            }
+            if (!blocks[block].name.empty()) kept.push_back(lines[label]);
+
+            for (size_t i = blocks[block].begin; i < blocks[block].end; ++i) {
+                const std::string &line = lines[i];
+                std::string name = definedName(line);
+                if (!name.empty()) {
+                    auto value = values.find(name);
+                    if (value != values.end() && value->second.kind == Lattice::CONSTANT) {
+                        ++constants;
+                        continue;
+                    }
+                    std::string rest = line.substr(name.size() + 3);
+                    if (startsWith(rest, "phi ")) {
+                        // Only the entries of edges that are taken
+                        std::string phi = name + " = " + rest.substr(0, rest.find(" [ ") + 1);
+                        bool first = true;
+                        for (const auto &entry : incoming(rest)) {
+                            if (!taken(entry.second, block)) continue;
+                            phi += (first ? "[ " : ", [ ") + entry.first + ", %" + entry.second + " ]";
+                            first = false;
+                        }
+                        kept.push_back(substitution.apply(phi));
+                        continue;
+                    }
+                } else if (startsWith(line, "br i1 ")) {
+                    Lattice value = operand(line.substr(6, line.find(", ") - 6));
+                    if (value.kind == Lattice::CONSTANT) {
+                        kept.push_back("br label %" + labelOperands(line)[value.value ? 0 : 1]);
+                        ++pruned;
+                        continue;
+                    }
+                }
+                kept.push_back(substitution.apply(line));
+            }
+        }
+        return kept;
+    }
+}
+
+std::string propagateConstants(const std::string &function, Statistics *statistics) {
+    std::vector<std::string> lines = splitLines(function);
+    Propagation propagation(lines);
+    // Malformed code is left for the IR verifier to report
+    if (!propagation.wellFormed()) return function;
+    propagation.solve();
+
+    unsigned long constants = 0, pruned = 0, removed = 0;
+    std::vector<std::string> kept = propagation.rewrite(constants, pruned, removed);
+
+    if (statistics) {
+        statistics->add("constant propagation values", constants);
+        statistics->add("constant propagation pruned branches", pruned);
+        statistics->add("constant propagation removed blocks", removed);
+    }
+    return joinLines(kept);
+}
@@ -0,0 +1,22 @@
+#ifndef CONSTANT_PROPAGATION_HPP
+#define CONSTANT_PROPAGATION_HPP
+
+#include <string>
+
+class Statistics;
+
+/* Sparse conditional constant propagation over the IR text of one function
+   (see ir_text.hpp). Starting from the entry block, values, slots and phis
+   are evaluated only along the edges that can be taken: a branch on a
+   constant condition follows just one of its targets, and the value of a
+   slot or phi at a join is the meet of what the taken edges bring. Slots
+   are allocas whose address never leaves the function, so calls do not
+   change them.
+
+   When nothing changes any more, values known to be constant replace
+   their uses, branches on constants become unconditional, and blocks no
+   taken edge reaches are removed. A function with a block that does not
+   end in a terminator is returned unchanged. */
+std::string propagateConstants(const std::string &function, Statistics *statistics);
+
+#endif // CONSTANT_PROPAGATION_HPP
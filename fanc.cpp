@@ -0,0 +1,226 @@
+#include "fanc.hpp"
+#include "nodes.hpp"
+#include "output.hpp"
+#include "parser.tab.h"
+#include "lex.yy.h"
+#include "semantic_analayzer_visitor.hpp"
+#include "code_generator.hpp"
+#include "source_splitter.hpp"
+#include "thread_pool.hpp"
+#include "compile_cache.hpp"
+#include "fingerprint.hpp"
+#include "incremental.hpp"
+#include "bytecode.hpp"
+#include "interpreter.hpp"
+#include "asm_generator.hpp"
+#include "reachability.hpp"
+#include "statistics.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+namespace fanc {
+
+    // Upper bound on the functions parsed at once. Keeps the parser stack small
+    // (Funcs is right recursive) and gives the front end independent pieces of work.
+    static const size_t FUNCS_PER_CHUNK = 64;
+
+    // Parses a chunk with a scanner instance of its own
+    static std::shared_ptr<ast::Funcs> parseChunk(const SourceChunk &chunk) {
+        yyscan_t scanner;
+        yylex_init(&scanner);
+        YY_BUFFER_STATE state = yy_scan_string(chunk.text.c_str(), scanner);
+        yyset_lineno(chunk.first_line, scanner);
+        ast::parsing_line = chunk.first_line;
+
+        std::shared_ptr<ast::Node> program;
+        try {
+            yyparse(scanner, program);
+        } catch (...) {
+            yy_delete_buffer(state, scanner);
+            yylex_destroy(scanner);
+            throw;
+        }
+        yy_delete_buffer(state, scanner);
+        yylex_destroy(scanner);
+
+        return std::dynamic_pointer_cast<ast::Funcs>(program);
+    }
+
+    // Parses the chunks concurrently and merges the function lists in order.
+    // Reports the error of the first failing chunk, like a single parse would.
+    static std::shared_ptr<ast::Funcs> parse(const std::string &source, unsigned jobs) {
+        std::vector<SourceChunk> chunks = splitSource(source, FUNCS_PER_CHUNK);
+        std::vector<std::shared_ptr<ast::Funcs>> parts(chunks.size());
+        std::vector<std::unique_ptr<output::CompileError>> errors(chunks.size());
+        std::atomic<size_t> first_error(chunks.size());
+
+        ThreadPool pool(std::min<size_t>(ThreadPool::defaultThreads(jobs), chunks.size()));
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            pool.submit([&chunks, &parts, &errors, &first_error, i] {
+                if (i > first_error.load()) return;
+                try {
+                    parts[i] = parseChunk(chunks[i]);
+                } catch (const output::CompileError &error) {
+                    errors[i] = std::make_unique<output::CompileError>(error);
+                } catch (const std::exception &error) {
+                    errors[i] = std::make_unique<output::CompileError>(output::internalError(error));
+                }
+                if (errors[i]) {
+                    size_t seen = first_error.load();
+                    while (i < seen && !first_error.compare_exchange_weak(seen, i)) {
+                    }
+                }
+            });
+        }
+        pool.wait();
+
+        auto funcs = std::make_shared<ast::Funcs>();
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            if (errors[i]) throw *errors[i];
+            funcs->funcs.insert(funcs->funcs.end(), parts[i]->funcs.begin(), parts[i]->funcs.end());
+        }
+        return funcs;
+    }
+
+    // Hash of the token stream and of the options that shape the output:
+    // whitespace, comments and line breaks do not change it. Empty if the
+    // source does not even scan.
+    static std::string programKey(const std::string &source, const Options &options) {
+        Fingerprint fingerprint;
+        fingerprint.add(version());
+        fingerprint.add(options.external_runtime ? 1 : 0);
+        fingerprint.add(static_cast<int>(options.backend));
+        fingerprint.add(options.optimize ? 1 : 0);
+        fingerprint.add(options.unroll);
+        fingerprint.add(options.inline_threshold);
+        fingerprint.add(options.memoize ? 1 : 0);
+
+        yyscan_t scanner;
+        yylex_init(&scanner);
+        YY_BUFFER_STATE state = yy_scan_string(source.c_str(), scanner);
+        YYSTYPE value;
+        bool scanned = true;
+        try {
+            for (int token = yylex(&value, scanner); token != 0; token = yylex(&value, scanner)) {
+                fingerprint.add(token);
+                // Operator tokens carry a node without operands
+                if (auto binop = std::dynamic_pointer_cast<ast::BinOp>(value)) {
+                    fingerprint.add(binop->op);
+                } else if (auto relop = std::dynamic_pointer_cast<ast::RelOp>(value)) {
+                    fingerprint.add(relop->op);
+                } else if (value) {
+                    FingerprintVisitor visitor(fingerprint);
+                    value->accept(visitor);
+                }
+                value = nullptr;
+            }
+        } catch (const output::CompileError &error) {
+            scanned = false;
+        }
+        yy_delete_buffer(state, scanner);
+        yylex_destroy(scanner);
+
+        return scanned ? fingerprint.hex() : "";
+    }
+
+    const std::string &version() {
+        static const std::string value = std::string("fanc hw5 ") + __DATE__ + " " + __TIME__;
+        return value;
+    }
+
+    Result compile(std::string_view source, const Options &options) {
+        Result result;
+        try {
+            std::string text(source);
+
+            // Only successful compilations of whole programs are cached:
+            // diagnostics carry line numbers, which the key deliberately
+            // ignores, and a module also returns its interface
+            std::string key;
+            if (options.cache && options.module.empty()) {
+                key = programKey(text, options);
+                if (!key.empty() && options.cache->lookup("program", key, result.ir)) {
+                    result.ok = true;
+                    return result;
+                }
+            }
+
+            std::shared_ptr<ast::Funcs> program = parse(text, options.jobs);
+
+            // Phase 1: Semantic Analysis
+            // Ensures type safety and validity before code generation.
+            SemanticAnalayzerVisitor semantic_visitor(options.jobs);
+            if (!options.module.empty()) semantic_visitor.compileModule(options.imports);
+            std::vector<std::string> check_keys;
+            if (options.incremental) {
+                check_keys = checkKeys(*program, options.imports);
+                std::vector<bool> skip(check_keys.size());
+                for (size_t i = 0; i < check_keys.size(); ++i) {
+                    skip[i] = options.incremental->checked(program->funcs[i]->id->value, check_keys[i]);
+                }
+                semantic_visitor.skipBodies(std::move(skip));
+            }
+            program->accept(semantic_visitor);
+            for (size_t i = 0; i < check_keys.size(); ++i) {
+                options.incremental->recordCheck(program->funcs[i]->id->value, check_keys[i]);
+            }
+
+            // A whole program only needs what main reaches
+            if (options.module.empty()) {
+                size_t removed = removeUnreachable(*program);
+                if (options.statistics) options.statistics->add("unreachable functions", removed);
+            }
+
+            // Phase 2: Code Generation
+            if (options.backend == Backend::ASM) {
+                // Lowered to the interpreter's bytecode, which the register allocator works on
+                bytecode::Program lowered;
+                bytecode::Compiler compiler(lowered);
+                program->accept(compiler);
+                result.ir = generateAssembly(lowered);
+            } else {
+                // Emits LLVM IR to the code buffer.
+                output::CodeBuffer buffer;
+                CodeGenerator code_gen_visitor(buffer, options);
+                program->accept(code_gen_visitor);
+
+                std::ostringstream ir;
+                ir << buffer;
+                result.ir = ir.str();
+            }
+            result.ok = true;
+            if (!options.module.empty()) result.interface = describeModule(options.module, *program);
+
+            if (!key.empty()) options.cache->store("program", key, result.ir);
+            if (options.incremental) options.incremental->commit();
+        } catch (const output::CompileError &error) {
+            result.diagnostics = error.what();
+        } catch (const std::exception &error) {
+            result.diagnostics = output::internalError(error).what();
+        }
+        return result;
+    }
+
+    bool interpret(std::string_view source, const Options &options, std::string &diagnostics, int &status) {
+        bytecode::Program bytecode_program;
+        try {
+            std::shared_ptr<ast::Funcs> program = parse(std::string(source), options.jobs);
+            SemanticAnalayzerVisitor semantic_visitor(options.jobs);
+            program->accept(semantic_visitor);
+
+            bytecode::Compiler compiler(bytecode_program);
+            program->accept(compiler);
+        } catch (const output::CompileError &error) {
+            diagnostics = error.what();
+            return false;
+        } catch (const std::exception &error) {
+            diagnostics = output::internalError(error).what();
+            return false;
+        }
+        status = runBytecode(bytecode_program, stdout);
+        return true;
+    }
+}
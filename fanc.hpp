@@ -0,0 +1,84 @@
+#ifndef FANC_HPP
+#define FANC_HPP
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "module_interface.hpp"
+
+class CompileCache;
+class IncrementalState;
+class Statistics;
+
+/* Library interface of the FanC compiler.
+   The compiler keeps no global state, so compile() may be called any number of
+   times in one process and from several threads at once. */
+
+namespace fanc {
+
+    enum class Backend {
+        // LLVM IR for lli, the JIT or llc
+        LLVM,
+        // x86-64 assembly for the system assembler (whole programs only)
+        ASM
+    };
+
+    struct Options {
+        // Threads used inside a single compilation (0 = one per hardware thread)
+        unsigned jobs = 1;
+        // Cache of compiled programs and functions, may be shared by concurrent compilations
+        std::shared_ptr<CompileCache> cache;
+        // Previous compilation of the same program; only changed functions are
+        // analyzed and generated again, and the state is updated on success
+        std::shared_ptr<IncrementalState> incremental;
+        // Name of the module when compiling one module of a larger program:
+        // main is not required, calls to the imported functions are checked
+        // against their summaries, and the IR is meant for the link step.
+        // Empty for a whole program.
+        std::string module;
+        std::vector<ModuleInterface> imports;
+        // Only declare the library (print, printi and the division error
+        // message), which is then linked in from the native runtime
+        bool external_runtime = false;
+        Backend backend = Backend::LLVM;
+        // Optimize the generated IR (off with -O0)
+        bool optimize = true;
+        // Instructions the copies of an unrolled loop may take together
+        // (--unroll=N, 0 turns unrolling off)
+        unsigned unroll = 64;
+        // How much larger than the call it replaces an inlined copy of a
+        // function may be (--inline-threshold N, 0 turns inlining off)
+        unsigned inline_threshold = 20;
+        // Cache the results of pure recursive functions in a table in front
+        // of their bodies (--memoize, see purity.hpp)
+        bool memoize = false;
+        // Counts what the optimizations removed or rewrote; nothing is
+        // counted when the result comes from the cache
+        std::shared_ptr<Statistics> statistics;
+    };
+
+    struct Result {
+        // True when the program compiled, ir then holds the generated code
+        bool ok = false;
+        // Generated LLVM IR, or assembly with the asm backend
+        std::string ir;
+        // The first error, formatted exactly as the command line compiler prints it
+        std::string diagnostics;
+        // Functions the module defines, filled when compiling a module
+        ModuleInterface interface;
+    };
+
+    // Compiles a FanC program into LLVM IR or assembly
+    Result compile(std::string_view source, const Options &options = Options());
+
+    // Checks a program and runs it on the bytecode interpreter instead of
+    // generating IR; the program writes to stdout. Returns false with the
+    // diagnostics if it does not compile, otherwise sets its exit status.
+    bool interpret(std::string_view source, const Options &options, std::string &diagnostics, int &status);
+
+    // Identifies this build of the compiler, part of every cache key
+    const std::string &version();
+}
+
+#endif // FANC_HPP
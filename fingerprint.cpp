@@ -0,0 +1,168 @@
+#include "fingerprint.hpp"
+
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+Fingerprint::Fingerprint() : low(14695981039346656037ULL), high(0x6c62272e07bb0142ULL) {}
+
+void Fingerprint::addBytes(const char *data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        low = (low ^ static_cast<unsigned char>(data[i])) * FNV_PRIME;
+        high = (high ^ static_cast<unsigned char>(data[i])) * FNV_PRIME;
+        // Decorrelate the second stream from the first
+        high ^= high >> 29;
+    }
+}
+
+void Fingerprint::add(const std::string &value) {
+    add(static_cast<long long>(value.size()));
+    addBytes(value.data(), value.size());
+}
+
+void Fingerprint::add(long long value) {
+    char bytes[8];
+    for (int i = 0; i < 8; ++i) {
+        bytes[i] = static_cast<char>(static_cast<unsigned long long>(value) >> (8 * i));
+    }
+    addBytes(bytes, sizeof(bytes));
+}
+
+std::string Fingerprint::hex() const {
+    static const char digits[] = "0123456789abcdef";
+    std::string result;
+    for (uint64_t part : {high, low}) {
+        for (int shift = 60; shift >= 0; shift -= 4) {
+            result += digits[(part >> shift) & 0xf];
+        }
+    }
+    return result;
+}
+
+FingerprintVisitor::FingerprintVisitor(Fingerprint &fingerprint) : fingerprint(fingerprint) {}
+
+void FingerprintVisitor::visit(ast::Num &node) {
+    fingerprint.add("num");
+    fingerprint.add(node.value);
+}
+
+void FingerprintVisitor::visit(ast::NumB &node) {
+    fingerprint.add("byte");
+    fingerprint.add(node.value);
+}
+
+void FingerprintVisitor::visit(ast::String &node) {
+    fingerprint.add("string");
+    fingerprint.add(node.value);
+}
+
+void FingerprintVisitor::visit(ast::Bool &node) {
+    fingerprint.add(node.value ? "true" : "false");
+}
+
+void FingerprintVisitor::visit(ast::ID &node) {
+    fingerprint.add("id");
+    fingerprint.add(node.value);
+    names.insert(node.value);
+}
+
+void FingerprintVisitor::visit(ast::BinOp &node) {
+    fingerprint.add("binop");
+    fingerprint.add(node.op);
+    AstWalker::visit(node);
+}
+
+void FingerprintVisitor::visit(ast::RelOp &node) {
+    fingerprint.add("relop");
+    fingerprint.add(node.op);
+    AstWalker::visit(node);
+}
+
+void FingerprintVisitor::visit(ast::Not &node) {
+    fingerprint.add("not");
+    AstWalker::visit(node);
+}
+
+void FingerprintVisitor::visit(ast::And &node) {
+    fingerprint.add("and");
+    AstWalker::visit(node);
+}
+
+void FingerprintVisitor::visit(ast::Or &node) {
+    fingerprint.add("or");
+    AstWalker::visit(node);
+}
+
+void FingerprintVisitor::visit(ast::Cast &node) {
+    fingerprint.add("cast");
+    fingerprint.add(node.target_type->type);
+    AstWalker::visit(node);
+}
+
+void FingerprintVisitor::visit(ast::Call &node) {
+    fingerprint.add("call");
+    fingerprint.add(node.func_id->value);
+    fingerprint.add(static_cast<long long>(node.args ? node.args->exps.size() : 0));
+    names.insert(node.func_id->value);
+    AstWalker::visit(node);
+}
+
+void FingerprintVisitor::visit(ast::Statements &node) {
+    fingerprint.add("block");
+    fingerprint.add(static_cast<long long>(node.statements.size()));
+    AstWalker::visit(node);
+}
+
+void FingerprintVisitor::visit(ast::Break &node) {
+    fingerprint.add("break");
+}
+
+void FingerprintVisitor::visit(ast::Continue &node) {
+    fingerprint.add("continue");
+}
+
+void FingerprintVisitor::visit(ast::Return &node) {
+    fingerprint.add("return");
+    fingerprint.add(node.exp ? 1 : 0);
+    AstWalker::visit(node);
+}
+
+void FingerprintVisitor::visit(ast::If &node) {
+    fingerprint.add("if");
+    fingerprint.add(node.otherwise ? 1 : 0);
+    AstWalker::visit(node);
+}
+
+void FingerprintVisitor::visit(ast::While &node) {
+    fingerprint.add("while");
+    AstWalker::visit(node);
+}
+
+void FingerprintVisitor::visit(ast::VarDecl &node) {
+    fingerprint.add("var");
+    fingerprint.add(node.type->type);
+    fingerprint.add(node.id->value);
+    fingerprint.add(node.init_exp ? 1 : 0);
+    names.insert(node.id->value);
+    AstWalker::visit(node);
+}
+
+void FingerprintVisitor::visit(ast::Assign &node) {
+    fingerprint.add("assign");
+    fingerprint.add(node.id->value);
+    names.insert(node.id->value);
+    AstWalker::visit(node);
+}
+
+void FingerprintVisitor::visit(ast::Formal &node) {
+    fingerprint.add("formal");
+    fingerprint.add(node.type->type);
+    fingerprint.add(node.id->value);
+    names.insert(node.id->value);
+}
+
+void FingerprintVisitor::visit(ast::FuncDecl &node) {
+    fingerprint.add("func");
+    fingerprint.add(node.return_type->type);
+    fingerprint.add(node.id->value);
+    fingerprint.add(static_cast<long long>(node.formals ? node.formals->formals.size() : 0));
+    AstWalker::visit(node);
+}
@@ -0,0 +1,68 @@
+#ifndef FINGERPRINT_HPP
+#define FINGERPRINT_HPP
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include "ast_walker.hpp"
+
+/* 128-bit content hash (two FNV-1a streams with different offset bases).
+   Values are added in a length-prefixed form, so distinct sequences of
+   values never produce the same byte stream. */
+class Fingerprint {
+public:
+    Fingerprint();
+
+    void add(const std::string &value);
+    void add(long long value);
+
+    // 32 hex digits
+    std::string hex() const;
+
+private:
+    uint64_t low;
+    uint64_t high;
+
+    void addBytes(const char *data, size_t size);
+};
+
+/* Fingerprints a subtree: node kinds, operators, literals, types and names,
+   but not line numbers, which never reach the generated code. Also collects
+   every identifier the subtree mentions (variables, formals and callees), so
+   callers can add the signatures the subtree depends on. */
+class FingerprintVisitor : public AstWalker {
+public:
+    explicit FingerprintVisitor(Fingerprint &fingerprint);
+
+    // Identifiers mentioned in the visited nodes
+    std::set<std::string> names;
+
+    using AstWalker::visit;
+    void visit(ast::Num &node) override;
+    void visit(ast::NumB &node) override;
+    void visit(ast::String &node) override;
+    void visit(ast::Bool &node) override;
+    void visit(ast::ID &node) override;
+    void visit(ast::BinOp &node) override;
+    void visit(ast::RelOp &node) override;
+    void visit(ast::Not &node) override;
+    void visit(ast::And &node) override;
+    void visit(ast::Or &node) override;
+    void visit(ast::Cast &node) override;
+    void visit(ast::Call &node) override;
+    void visit(ast::Statements &node) override;
+    void visit(ast::Break &node) override;
+    void visit(ast::Continue &node) override;
+    void visit(ast::Return &node) override;
+    void visit(ast::If &node) override;
+    void visit(ast::While &node) override;
+    void visit(ast::VarDecl &node) override;
+    void visit(ast::Assign &node) override;
+    void visit(ast::Formal &node) override;
+    void visit(ast::FuncDecl &node) override;
+
+private:
+    Fingerprint &fingerprint;
+};
+
+#endif // FINGERPRINT_HPP
@@ -0,0 +1,138 @@
+#include "incremental.hpp"
+#include "fanc.hpp"
+#include "fingerprint.hpp"
+#include <cstdio>
+#include <fstream>
+
+// First line of a state file
+static const char *STATE_MAGIC = "fanc-incremental 1";
+
+/* The file holds one record per function:
+       <name> <check key> <code key> <code size>\n<code>
+   An unreadable or foreign file simply means there is no previous state. */
+IncrementalState::IncrementalState(const std::string &path)
+    : path(path), functions(0), analyzed(0), generated(0) {
+    std::ifstream in(path, std::ios::binary);
+    std::string magic;
+    if (!std::getline(in, magic) || magic != STATE_MAGIC) return;
+
+    std::string name;
+    Function function;
+    size_t size;
+    while (in >> name >> function.check_key >> function.code_key >> size && in.get() == '\n') {
+        function.code.resize(size);
+        if (!in.read(&function.code[0], size)) {
+            previous.clear();
+            return;
+        }
+        previous[name] = function;
+    }
+}
+
+bool IncrementalState::checked(const std::string &name, const std::string &check_key) const {
+    auto function = previous.find(name);
+    return function != previous.end() && function->second.check_key == check_key;
+}
+
+bool IncrementalState::lookup(const std::string &name, const std::string &code_key, std::string &code) const {
+    auto function = previous.find(name);
+    if (function == previous.end() || function->second.code_key != code_key) return false;
+    code = function->second.code;
+    return true;
+}
+
+void IncrementalState::recordCheck(const std::string &name, const std::string &check_key) {
+    std::lock_guard<std::mutex> guard(lock);
+    ++functions;
+    if (!checked(name, check_key)) ++analyzed;
+    current[name].check_key = check_key;
+}
+
+void IncrementalState::recordCode(const std::string &name, const std::string &code_key, const std::string &code) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto function = previous.find(name);
+    if (function == previous.end() || function->second.code_key != code_key) ++generated;
+    current[name].code_key = code_key;
+    current[name].code = code;
+}
+
+bool IncrementalState::commit() {
+    std::lock_guard<std::mutex> guard(lock);
+    previous.swap(current);
+    current.clear();
+
+    // Written next to the target and renamed, so a crash never leaves half a state
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out << STATE_MAGIC << '\n';
+        for (const auto &function : previous) {
+            out << function.first << ' ' << function.second.check_key << ' ' << function.second.code_key
+                << ' ' << function.second.code.size() << '\n' << function.second.code;
+        }
+        if (!out) return false;
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+void IncrementalState::report(std::ostream &os) const {
+    std::lock_guard<std::mutex> guard(lock);
+    os << "incremental: " << analyzed << " of " << functions << " functions re-analyzed, "
+       << generated << " regenerated" << std::endl;
+}
+
+// Return and argument types, the part of a function the callers depend on
+static std::string signature(const ast::FuncDecl &function) {
+    std::string result = std::to_string(function.return_type->type) + "(";
+    if (function.formals) {
+        for (const auto &formal : function.formals->formals) {
+            result += std::to_string(formal->type->type) + ",";
+        }
+    }
+    return result + ")";
+}
+
+// Return and argument types of an imported function
+static std::string signature(const FunctionSignature &function) {
+    std::string result = std::to_string(function.return_type) + "(";
+    for (auto argument : function.arguments) {
+        result += std::to_string(argument) + ",";
+    }
+    return result + ")";
+}
+
+std::vector<std::string> checkKeys(const ast::Funcs &program, const std::vector<ModuleInterface> &imports) {
+    // Every function with the name, so that duplicates change the key too
+    std::unordered_map<std::string, std::string> signatures;
+    signatures["print"] = "library print";
+    signatures["printi"] = "library printi";
+    for (const auto &module : imports) {
+        for (const auto &function : module.functions) {
+            signatures[function.name] += "import " + signature(function);
+        }
+    }
+    for (const auto &function : program.funcs) {
+        signatures[function->id->value] += signature(*function);
+    }
+
+    std::vector<std::string> keys;
+    keys.reserve(program.funcs.size());
+    for (const auto &function : program.funcs) {
+        Fingerprint fingerprint;
+        fingerprint.add(fanc::version());
+        fingerprint.add("check");
+
+        FingerprintVisitor visitor(fingerprint);
+        function->accept(visitor);
+
+        // A name that is not a function matters as well: declaring a function
+        // with that name turns a valid variable into a redefinition
+        for (const auto &name : visitor.names) {
+            auto found = signatures.find(name);
+            fingerprint.add(name);
+            fingerprint.add(found == signatures.end() ? "-" : found->second);
+        }
+        keys.push_back(fingerprint.hex());
+    }
+    return keys;
+}
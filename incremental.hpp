@@ -0,0 +1,65 @@
+#ifndef INCREMENTAL_HPP
+#define INCREMENTAL_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "nodes.hpp"
+#include "module_interface.hpp"
+
+/* State carried from one compilation of a program to the next.
+   For every function the previous successful compile recorded two keys and
+   the generated code:
+   - the check key covers the body and the full signature of every function
+     whose name the body mentions; a function whose check key is unchanged
+     passed semantic analysis before and passes it again.
+   - the code key also covers the globals its string literals were given;
+     when it is unchanged the recorded code is exactly what generation would
+     produce.
+   The state is loaded from a file when created and only written back by
+   commit(), after a successful compilation. It belongs to one program, so it
+   must not be shared by compilations of different sources. */
+class IncrementalState {
+public:
+    explicit IncrementalState(const std::string &path);
+
+    // True if the function passed semantic analysis under this check key last time
+    bool checked(const std::string &name, const std::string &check_key) const;
+
+    // Returns true and fills code if the function was generated under this code key last time
+    bool lookup(const std::string &name, const std::string &code_key, std::string &code) const;
+
+    // Records the keys of a function of the current compilation
+    void recordCheck(const std::string &name, const std::string &check_key);
+    void recordCode(const std::string &name, const std::string &code_key, const std::string &code);
+
+    // Makes the current compilation the previous one and writes it to the file
+    bool commit();
+
+    // Writes how many functions were re-analyzed and regenerated
+    void report(std::ostream &os) const;
+
+private:
+    struct Function {
+        std::string check_key;
+        std::string code_key;
+        std::string code;
+    };
+
+    std::string path;
+    std::unordered_map<std::string, Function> previous;
+
+    mutable std::mutex lock;
+    std::unordered_map<std::string, Function> current;
+    uint64_t functions;
+    uint64_t analyzed;
+    uint64_t generated;
+};
+
+// Check keys of every function of a program, in source order
+std::vector<std::string> checkKeys(const ast::Funcs &program, const std::vector<ModuleInterface> &imports);
+
+#endif // INCREMENTAL_HPP
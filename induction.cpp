@@ -0,0 +1,477 @@
+#include "induction.hpp"
+#include "ir_text.hpp"
+#include "statistics.hpp"
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace ir;
+
+namespace {
+    struct Definition {
+        std::string rest;
+        size_t line;
+    };
+
+    // "<op> i32 <a>, <b>"
+    bool binary(const std::string &rest, const std::string &op, std::string &a, std::string &b) {
+        std::string prefix = op + " i32 ";
+        if (!startsWith(rest, prefix)) return false;
+        size_t comma = rest.find(", ", prefix.size());
+        if (comma == std::string::npos) return false;
+        a = rest.substr(prefix.size(), comma - prefix.size());
+        b = rest.substr(comma + 2);
+        return true;
+    }
+
+    // "store i32 <value>, i32* <slot>"
+    bool stored(const std::string &line, std::string &value, std::string &slot) {
+        if (!startsWith(line, "store i32 ")) return false;
+        size_t comma = line.find(", i32* ");
+        if (comma == std::string::npos) return false;
+        value = line.substr(10, comma - 10);
+        slot = line.substr(comma + 7);
+        return true;
+    }
+
+    // The slot of "load i32, i32* <slot>", empty for other instructions
+    std::string loaded(const std::string &rest) {
+        return startsWith(rest, "load i32, i32* ") ? rest.substr(15) : "";
+    }
+
+    // The step of "add i32 <a>, K", "add i32 K, <a>" and "sub i32 <a>, K", 0 for anything else
+    long long stepOf(const std::string &rest, std::string &operand) {
+        std::string a, b;
+        if (binary(rest, "add", a, b)) {
+            if (isConstant(b)) {
+                operand = a;
+                return std::stoll(b);
+            }
+            if (isConstant(a)) {
+                operand = b;
+                return std::stoll(a);
+            }
+        } else if (binary(rest, "sub", a, b) && isConstant(b)) {
+            operand = a;
+            return -std::stoll(b);
+        }
+        return 0;
+    }
+
+    std::string wrapped(long long value) {
+        return std::to_string(static_cast<int32_t>(static_cast<uint32_t>(value)));
+    }
+
+    std::string swapped(const std::string &predicate) {
+        static const std::map<std::string, std::string> mirror = {
+            {"slt", "sgt"}, {"sgt", "slt"}, {"sle", "sge"}, {"sge", "sle"}, {"eq", "eq"}, {"ne", "ne"}};
+        auto found = mirror.find(predicate);
+        return found == mirror.end() ? "" : found->second;
+    }
+
+    // Replaces a single block counting loop by the closed form of what it computes
+    bool closeForm(std::vector<std::string> &lines, const Loop &loop) {
+        const std::string &header = loop.header;
+        for (size_t i = loop.begin + 1; i <= loop.end; ++i) {
+            if (isLabel(lines[i])) return false;
+        }
+        // br i1 <condition>, label %<header>, label %<exit>
+        const std::string &branch = lines[loop.end];
+        std::vector<std::string> targets = labelOperands(branch);
+        if (!startsWith(branch, "br i1 ") || targets.size() != 2 || targets[0] != header || targets[1] == header) {
+            return false;
+        }
+        std::string condition = branch.substr(6, branch.find(", ") - 6);
+        std::string exit = targets[1];
+
+        std::unordered_map<std::string, Definition> definitions;
+        // slot -> the value the loop stores to it, and where
+        struct Store {
+            std::string value;
+            size_t line;
+        };
+        std::unordered_map<std::string, Store> stores;
+        for (size_t i = loop.begin + 1; i < loop.end; ++i) {
+            std::string name = definedName(lines[i]);
+            std::string value, slot;
+            if (!name.empty()) {
+                definitions[name] = {lines[i].substr(name.size() + 3), i};
+            } else if (stored(lines[i], value, slot) && !stores.count(slot)) {
+                stores[slot] = {value, i};
+            } else {
+                // Calls, a second store to a slot and whatever else
+                return false;
+            }
+        }
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (i >= loop.begin && i <= loop.end) continue;
+            bool escapes = false;
+            forEachName(lines[i], [&](size_t begin, size_t end) {
+                if (definitions.count(lines[i].substr(begin, end - begin))) escapes = true;
+            });
+            if (escapes) return false;
+        }
+
+        auto invariant = [&](const std::string &value) {
+            return isConstant(value) || (value[0] == '%' && !definitions.count(value));
+        };
+        // The slot whose value at the start of the iteration a load reads
+        auto loadOf = [&](const std::string &value) -> std::string {
+            auto definition = definitions.find(value);
+            if (definition == definitions.end()) return "";
+            std::string slot = loaded(definition->second.rest);
+            auto store = stores.find(slot);
+            if (slot.empty() || store == stores.end() || store->second.line < definition->second.line) return "";
+            return slot;
+        };
+        // A load after the slot's store reads the stored value
+        auto resolve = [&](const std::string &value) {
+            auto definition = definitions.find(value);
+            if (definition == definitions.end()) return value;
+            auto store = stores.find(loaded(definition->second.rest));
+            return store != stores.end() && store->second.line < definition->second.line ? store->second.value : value;
+        };
+        // The operand of "and i32 <value>, 255", the value itself if it is not masked
+        auto unmasked = [&](const std::string &value, bool &masked) {
+            auto definition = definitions.find(value);
+            std::string a, b;
+            masked = definition != definitions.end() && binary(definition->second.rest, "and", a, b) && b == "255";
+            return masked ? a : value;
+        };
+
+        // The counter: stepped by one towards an invariant bound the exit test compares its new value with
+        auto test = definitions.find(condition);
+        if (test == definitions.end() || !startsWith(test->second.rest, "icmp ")) return false;
+        // icmp <predicate> i32 <left>, <right>
+        std::string predicate = test->second.rest.substr(5, test->second.rest.find(' ', 5) - 5);
+        std::string left, right;
+        if (!binary(test->second.rest, "icmp " + predicate, left, right)) return false;
+        left = resolve(left);
+        right = resolve(right);
+        std::string counter, next, bound, sum;
+        long long step = 0;
+        for (const auto &store : stores) {
+            std::string value = store.second.value;
+            bool masked;
+            std::string unmasked_value = unmasked(value, masked);
+            auto definition = definitions.find(unmasked_value);
+            std::string operand;
+            if (definition == definitions.end()) continue;
+            long long by = stepOf(definition->second.rest, operand);
+            if ((by != 1 && by != -1) || loadOf(operand) != store.first) continue;
+
+            std::string direction = predicate, limit;
+            if (left == value && invariant(right)) {
+                limit = right;
+            } else if (right == value && invariant(left)) {
+                direction = swapped(predicate);
+                limit = left;
+            } else {
+                continue;
+            }
+            if (!((direction == "slt" && by == 1) || (direction == "sgt" && by == -1))) continue;
+            // A byte counter wraps at 256, which a constant byte bound never lets it reach
+            if (masked && !(isConstant(limit) && std::stoll(limit) >= 0 && std::stoll(limit) <= 255)) continue;
+            counter = store.first;
+            next = value;
+            sum = unmasked_value;
+            bound = limit;
+            step = by;
+            break;
+        }
+        if (counter.empty()) return false;
+
+        // Everything else the loop stores adds to or subtracts from the slot's own value
+        struct Accumulator {
+            std::string slot;
+            bool subtract, masked;
+            // What is added: an invariant value, or the counter before or after its step
+            std::string value;
+            bool counter, after;
+            // Invariant factor of the counter, if any
+            std::string factor;
+        };
+        std::vector<Accumulator> accumulators;
+        std::unordered_set<std::string> recognized = {condition, next, sum};
+        for (const auto &store : stores) {
+            if (store.first == counter) continue;
+            Accumulator accumulator = {store.first, false, false, "", false, false, ""};
+            std::string value = unmasked(store.second.value, accumulator.masked);
+            auto definition = definitions.find(value);
+            if (definition == definitions.end()) return false;
+            std::string a, b, operand;
+            if (binary(definition->second.rest, "add", a, b)) {
+                if (loadOf(a) == store.first) {
+                    operand = b;
+                } else if (loadOf(b) == store.first) {
+                    operand = a;
+                } else {
+                    return false;
+                }
+            } else if (binary(definition->second.rest, "sub", a, b) && loadOf(a) == store.first) {
+                operand = b;
+                accumulator.subtract = true;
+            } else {
+                return false;
+            }
+            operand = resolve(operand);
+            recognized.insert(store.second.value);
+            recognized.insert(value);
+
+            auto isCounter = [&](const std::string &value, bool &after) {
+                after = value == next || value == sum;
+                return after || loadOf(value) == counter;
+            };
+            std::string p, q;
+            auto product = definitions.find(operand);
+            if (invariant(operand)) {
+                accumulator.value = operand;
+            } else if (isCounter(operand, accumulator.after)) {
+                accumulator.counter = true;
+            } else if (product != definitions.end() && binary(product->second.rest, "mul", p, q)) {
+                if (isCounter(p, accumulator.after) && invariant(q)) {
+                    accumulator.factor = q;
+                } else if (isCounter(q, accumulator.after) && invariant(p)) {
+                    accumulator.factor = p;
+                } else {
+                    return false;
+                }
+                accumulator.counter = true;
+                recognized.insert(operand);
+            } else {
+                return false;
+            }
+            accumulators.push_back(accumulator);
+        }
+        // Nothing else is computed, besides the loads of these slots
+        for (const auto &definition : definitions) {
+            if (!recognized.count(definition.first) && !stores.count(loaded(definition.second.rest))) return false;
+        }
+
+        std::string name = "%" + header + ".";
+        std::vector<std::string> form = {
+            lines[loop.begin],
+            name + "first = load i32, i32* " + counter,
+            name + "from = sext i32 " + name + "first to i64",
+            name + "to = sext i32 " + bound + " to i64",
+            name + "trips = sub i64 " + (step > 0 ? name + "to, " + name + "from" : name + "from, " + name + "to"),
+            name + "counts = icmp sgt i64 " + name + "trips, 0",
+            "br i1 " + name + "counts, label " + name + "closed, label " + name + "loop",
+            header + ".closed:",
+        };
+        bool series = false;
+        for (const auto &accumulator : accumulators) {
+            series |= accumulator.counter;
+        }
+        if (!accumulators.empty()) form.push_back(name + "times = trunc i64 " + name + "trips to i32");
+        if (series) {
+            // The sum of 0 .. trips - 1; the product fits 64 bits before the halving
+            form.push_back(name + "less = sub i64 " + name + "trips, 1");
+            form.push_back(name + "pairs = mul i64 " + name + "trips, " + name + "less");
+            form.push_back(name + "half = lshr i64 " + name + "pairs, 1");
+            form.push_back(name + "triangle = trunc i64 " + name + "half to i32");
+        }
+        std::string add = step > 0 ? "add" : "sub";
+        for (size_t k = 0; k < accumulators.size(); ++k) {
+            const Accumulator &accumulator = accumulators[k];
+            std::string n = std::to_string(k);
+            form.push_back(name + "old" + n + " = load i32, i32* " + accumulator.slot);
+            std::string total = name + "total" + n;
+            if (!accumulator.counter) {
+                form.push_back(total + " = mul i32 " + name + "times, " + accumulator.value);
+            } else {
+                std::string base = name + "first";
+                if (accumulator.after) {
+                    base = name + "base" + n;
+                    form.push_back(base + " = add i32 " + name + "first, " + std::to_string(step));
+                }
+                form.push_back(name + "scaled" + n + " = mul i32 " + name + "times, " + base);
+                std::string series = accumulator.factor.empty() ? total : name + "series" + n;
+                form.push_back(series + " = " + add + " i32 " + name + "scaled" + n + ", " + name + "triangle");
+                if (!accumulator.factor.empty()) {
+                    form.push_back(total + " = mul i32 " + series + ", " + accumulator.factor);
+                }
+            }
+            std::string result = name + "new" + n;
+            form.push_back(result + " = " + (accumulator.subtract ? "sub" : "add") + " i32 " + name + "old" + n +
+                           ", " + total);
+            if (accumulator.masked) {
+                form.push_back(name + "byte" + n + " = and i32 " + result + ", 255");
+                result = name + "byte" + n;
+            }
+            form.push_back("store i32 " + result + ", i32* " + accumulator.slot);
+        }
+        form.push_back("store i32 " + bound + ", i32* " + counter);
+        form.push_back("br label %" + exit);
+
+        // When the counter starts past its bound the loop runs as it is
+        form.push_back(header + ".loop:");
+        for (size_t i = loop.begin + 1; i < loop.end; ++i) {
+            form.push_back(lines[i]);
+        }
+        form.push_back(retarget(branch, header, header + ".loop"));
+
+        lines.erase(lines.begin() + loop.begin, lines.begin() + loop.end + 1);
+        lines.insert(lines.begin() + loop.begin, form.begin(), form.end());
+        return true;
+    }
+}
+
+namespace {
+    // Turns multiplications of induction variables by constants into slots advanced with them
+    unsigned long strengthReduce(std::vector<std::string> &lines, const Loop &loop) {
+        std::unordered_map<std::string, Definition> definitions;
+        // Index of the label of the block of every line of the loop
+        std::vector<size_t> block(loop.end + 1, loop.begin);
+        std::unordered_map<std::string, std::vector<size_t>> stores;
+        for (size_t i = loop.begin; i <= loop.end; ++i) {
+            block[i] = isLabel(lines[i]) ? i : block[i - 1];
+            std::string name = definedName(lines[i]);
+            if (!name.empty()) {
+                definitions[name] = {lines[i].substr(name.size() + 3), i};
+            } else if (startsWith(lines[i], "store ")) {
+                stores[lines[i].substr(lines[i].rfind("* ") + 2)].push_back(i);
+            }
+        }
+        // The load's slot, if nothing stores to it between the load and the line
+        auto current = [&](const std::string &value, size_t line) -> std::string {
+            auto definition = definitions.find(value);
+            if (definition == definitions.end() || block[definition->second.line] != block[line]) return "";
+            std::string slot = loaded(definition->second.rest);
+            if (slot.empty()) return "";
+            for (size_t store : stores[slot]) {
+                if (store > definition->second.line && store < line) return "";
+            }
+            return slot;
+        };
+
+        // slot -> the step of every store to it, if they all add constants to its current value
+        std::unordered_map<std::string, std::map<size_t, long long>> variables;
+        for (const auto &slot : stores) {
+            if (slot.first[0] != '%' || definitions.count(slot.first)) continue;
+            std::map<size_t, long long> steps;
+            for (size_t store : slot.second) {
+                std::string value, target, operand;
+                if (!stored(lines[store], value, target)) break;
+                auto definition = definitions.find(value);
+                if (definition == definitions.end()) break;
+                long long step = stepOf(definition->second.rest, operand);
+                if (step == 0 || current(operand, store) != slot.first) break;
+                steps[store] = step;
+            }
+            if (steps.size() == slot.second.size()) variables[slot.first] = steps;
+        }
+
+        // (variable, factor) -> the multiplications of the variable by it
+        std::map<std::pair<std::string, long long>, std::vector<size_t>> products;
+        for (const auto &definition : definitions) {
+            std::string a, b;
+            if (!binary(definition.second.rest, "mul", a, b)) continue;
+            if (isConstant(a)) std::swap(a, b);
+            if (!isConstant(b)) continue;
+            long long factor = std::stoll(b);
+            std::string slot = current(a, definition.second.line);
+            if (factor == 0 || factor == 1 || factor == -1 || !variables.count(slot)) continue;
+            products[{slot, factor}].push_back(definition.second.line);
+        }
+        if (products.empty()) return 0;
+
+        // The slots live for the whole function, the preheader only sets them
+        std::vector<std::string> allocas, start;
+        std::unordered_map<size_t, std::vector<std::string>> after;
+        unsigned long reduced = 0;
+        for (const auto &product : products) {
+            const std::string &variable = product.first.first;
+            long long factor = product.first.second;
+            std::string slot = variable + "." + loop.header + ".by" +
+                               (factor < 0 ? "minus" + std::to_string(-factor) : std::to_string(factor));
+            allocas.push_back(slot + " = alloca i32");
+            start.push_back(slot + ".first = load i32, i32* " + variable);
+            start.push_back(slot + ".start = mul i32 " + slot + ".first, " + std::to_string(factor));
+            start.push_back("store i32 " + slot + ".start, i32* " + slot);
+            size_t n = 0;
+            for (const auto &step : variables[variable]) {
+                std::string k = std::to_string(n++);
+                after[step.first].push_back(slot + ".old" + k + " = load i32, i32* " + slot);
+                after[step.first].push_back(slot + ".new" + k + " = add i32 " + slot + ".old" + k + ", " +
+                                            wrapped(step.second * factor));
+                after[step.first].push_back("store i32 " + slot + ".new" + k + ", i32* " + slot);
+            }
+            for (size_t line : product.second) {
+                lines[line] = definedName(lines[line]) + " = load i32, i32* " + slot;
+                ++reduced;
+            }
+        }
+
+        // A preheader hoistInvariants made ends right before the loop; otherwise one is added
+        std::string preheader = loop.header + ".preheader";
+        bool existing = false;
+        for (size_t i = loop.begin; i-- > 0;) {
+            if (isLabel(lines[i])) {
+                existing = lines[i] == preheader + ":";
+                break;
+            }
+        }
+        std::vector<std::string> result;
+        for (size_t i = 0; i < lines.size(); ++i) {
+            bool inside = i >= loop.begin && i <= loop.end;
+            if (i == loop.begin) {
+                if (existing) {
+                    // Before the preheader's branch into the loop
+                    result.pop_back();
+                } else {
+                    result.push_back(preheader + ":");
+                }
+                result.insert(result.end(), start.begin(), start.end());
+                result.push_back("br label %" + loop.header);
+            }
+            result.push_back(inside || existing ? lines[i] : retarget(lines[i], loop.header, preheader));
+            auto extra = after.find(i);
+            if (inside && extra != after.end()) result.insert(result.end(), extra->second.begin(), extra->second.end());
+        }
+        // The allocas go to the entry block, right after its label
+        size_t entry = isLabel(result[1]) ? 2 : 1;
+        result.insert(result.begin() + entry, allocas.begin(), allocas.end());
+        lines.swap(result);
+        return reduced;
+    }
+}
+
+std::string reduceInductions(const std::string &function, Statistics *statistics) {
+    // Phis name the blocks they are entered from, a preheader would be a new one
+    if (function.find(" = phi ") != std::string::npos) return function;
+
+    std::vector<std::string> lines = splitLines(function);
+    unsigned long closed = 0, reduced = 0;
+
+    std::unordered_set<std::string> done;
+    for (;;) {
+        // Inner loops first
+        std::vector<Loop> loops = findLoops(lines);
+        const Loop *next = nullptr;
+        for (const auto &loop : loops) {
+            if (done.count(loop.header)) continue;
+            if (!next || loop.end - loop.begin < next->end - next->begin) next = &loop;
+        }
+        if (!next) break;
+        Loop loop = *next;
+        done.insert(loop.header);
+        if (!singleEntry(lines, loop)) continue;
+
+        if (closeForm(lines, loop)) {
+            // What runs when the closed form does not apply stays as it is
+            done.insert(loop.header + ".loop");
+            ++closed;
+        } else {
+            reduced += strengthReduce(lines, loop);
+        }
+    }
+
+    if (statistics) {
+        statistics->add("induction loops replaced by closed forms", closed);
+        statistics->add("induction multiplications reduced", reduced);
+    }
+    return joinLines(lines);
+}
@@ -0,0 +1,28 @@
+#ifndef INDUCTION_HPP
+#define INDUCTION_HPP
+
+#include <string>
+
+class Statistics;
+
+/* Induction variables of the loops in the IR text of one function (see
+   ir_text.hpp). An induction variable is a slot every store of the loop
+   sets to its own value plus a constant, loaded in the same block.
+
+   - Multiplications of an induction variable by a constant are strength
+     reduced: a slot of its own keeps the product, set in the preheader
+     and advanced next to every store of the variable, and the
+     multiplication becomes a load of it.
+   - A loop of a single block that counts a variable by one up to an
+     invariant bound (i < n) or down to it (i > n), and otherwise only
+     adds to or subtracts from accumulator slots values that are
+     invariant, the counter or multiples of it, is replaced by the closed
+     form of its result. The trip count is taken from the values the loop
+     is entered with; if the loop would not count to its bound from there,
+     the original loop runs. i32 arithmetic wraps, so the closed form is
+     computed modulo 2^32 like the loop. A byte counter is only taken when
+     the bound is a constant byte, so it never wraps; byte accumulators
+     are masked at the end, as every iteration would have done. */
+std::string reduceInductions(const std::string &function, Statistics *statistics);
+
+#endif // INDUCTION_HPP
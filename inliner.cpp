@@ -0,0 +1,130 @@
+#include "inliner.hpp"
+#include "ast_walker.hpp"
+#include <algorithm>
+#include <functional>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+    // Statements and expressions of a body, and the calls in it
+    class SizeCounter : public AstWalker {
+    public:
+        unsigned long size = 0;
+        std::vector<ast::Call*> calls;
+
+        using AstWalker::visit;
+        void visit(ast::Num &node) override { ++size; }
+        void visit(ast::NumB &node) override { ++size; }
+        void visit(ast::String &node) override { ++size; }
+        void visit(ast::Bool &node) override { ++size; }
+        void visit(ast::ID &node) override { ++size; }
+        void visit(ast::BinOp &node) override { ++size; AstWalker::visit(node); }
+        void visit(ast::RelOp &node) override { ++size; AstWalker::visit(node); }
+        void visit(ast::Not &node) override { ++size; AstWalker::visit(node); }
+        void visit(ast::And &node) override { ++size; AstWalker::visit(node); }
+        void visit(ast::Or &node) override { ++size; AstWalker::visit(node); }
+        void visit(ast::Cast &node) override { ++size; AstWalker::visit(node); }
+        void visit(ast::Call &node) override {
+            ++size;
+            calls.push_back(&node);
+            AstWalker::visit(node);
+        }
+        void visit(ast::Break &node) override { ++size; }
+        void visit(ast::Continue &node) override { ++size; }
+        void visit(ast::Return &node) override { ++size; AstWalker::visit(node); }
+        void visit(ast::If &node) override { ++size; AstWalker::visit(node); }
+        void visit(ast::While &node) override { ++size; AstWalker::visit(node); }
+        void visit(ast::VarDecl &node) override { ++size; AstWalker::visit(node); }
+        void visit(ast::Assign &node) override { ++size; AstWalker::visit(node); }
+    };
+}
+
+std::unordered_map<std::string, InlineCandidate> inlineCandidates(ast::Funcs &program, unsigned threshold) {
+    std::unordered_map<std::string, InlineCandidate> candidates;
+    std::unordered_map<std::string, std::vector<std::string>> calls;
+    std::unordered_map<std::string, std::vector<ast::Call*>> sites;
+    for (const auto &func : program.funcs) {
+        SizeCounter counter;
+        func->body->accept(counter);
+        InlineCandidate &candidate = candidates[func->id->value];
+        candidate.func = func;
+        candidate.size = counter.size;
+        for (ast::Call *call : counter.calls) {
+            candidate.callees.push_back(call->func_id->value);
+        }
+        calls[func->id->value] = candidate.callees;
+        sites[func->id->value] = counter.calls;
+    }
+
+    // Functions on a cycle of the call graph: the strongly connected
+    // components (Tarjan) of more than one function, or calling themselves
+    std::unordered_set<std::string> recursive;
+    std::unordered_map<std::string, size_t> index, lowest;
+    std::unordered_set<std::string> on_stack;
+    std::vector<std::string> stack;
+    std::function<void(const std::string &)> search = [&](const std::string &name) {
+        size_t number = index.size();
+        index[name] = lowest[name] = number;
+        stack.push_back(name);
+        on_stack.insert(name);
+        for (const auto &callee : calls[name]) {
+            if (callee == name) recursive.insert(name);
+            if (!calls.count(callee)) continue;
+            if (!index.count(callee)) {
+                search(callee);
+                lowest[name] = std::min(lowest[name], lowest[callee]);
+            } else if (on_stack.count(callee)) {
+                lowest[name] = std::min(lowest[name], index[callee]);
+            }
+        }
+        if (lowest[name] != index[name]) return;
+        std::vector<std::string> component;
+        do {
+            component.push_back(stack.back());
+            on_stack.erase(stack.back());
+            stack.pop_back();
+        } while (component.back() != name);
+        if (component.size() > 1) recursive.insert(component.begin(), component.end());
+    };
+    for (const auto &func : program.funcs) {
+        if (!index.count(func->id->value)) search(func->id->value);
+    }
+    for (const auto &name : recursive) {
+        candidates.erase(name);
+    }
+    // Called by the runtime, never by the program
+    candidates.erase("main");
+
+    // A copy holds the copies of the calls inlined into it in turn; the
+    // candidates call no chain back to themselves, so callees come first
+    std::unordered_set<std::string> sized;
+    std::function<void(const std::string &)> expand = [&](const std::string &name) {
+        if (!sized.insert(name).second) return;
+        InlineCandidate &candidate = candidates[name];
+        for (ast::Call *call : sites[name]) {
+            auto callee = candidates.find(call->func_id->value);
+            if (callee == candidates.end()) continue;
+            expand(callee->first);
+            if (worthInlining(callee->second, *call, threshold)) candidate.size += callee->second.size;
+        }
+    };
+    for (const auto &func : program.funcs) {
+        if (candidates.count(func->id->value)) expand(func->id->value);
+    }
+    return candidates;
+}
+
+bool worthInlining(const InlineCandidate &callee, const ast::Call &call, unsigned threshold) {
+    if (threshold == 0) return false;
+    unsigned long saved = 2;
+    if (call.args) {
+        for (const auto &arg : call.args->exps) {
+            saved += 2;
+            if (std::dynamic_pointer_cast<ast::Num>(arg) || std::dynamic_pointer_cast<ast::NumB>(arg) ||
+                std::dynamic_pointer_cast<ast::Bool>(arg)) {
+                saved += 3;
+            }
+        }
+    }
+    return callee.size <= threshold + saved;
+}
@@ -0,0 +1,34 @@
+#ifndef INLINER_HPP
+#define INLINER_HPP
+
+#include "nodes.hpp"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Inlining of small functions. CodeGenerator generates the body of such a
+   function in place of a call to it: the arguments go to fresh slots, the
+   callee sees none of the caller's variables or loops, and a return stores
+   its value and jumps to the block after the copy. A callee is a candidate
+   when it is defined in the program and no chain of calls leads from it
+   back to itself, so copies of copies always end. */
+
+struct InlineCandidate {
+    std::shared_ptr<ast::FuncDecl> func;
+    // Statements and expressions in the body, with those of the calls in it
+    // that are inlined as well: what a copy costs
+    unsigned long size = 0;
+    // The functions the body calls
+    std::vector<std::string> callees;
+};
+
+// The functions of the program calls to which may be inlined, by name
+std::unordered_map<std::string, InlineCandidate> inlineCandidates(ast::Funcs &program, unsigned threshold);
+
+// The cost model: a copy may be threshold larger than what the call saves,
+// which is the call and the slots of its arguments, and more with constant
+// arguments, which fold into the copy
+bool worthInlining(const InlineCandidate &callee, const ast::Call &call, unsigned threshold);
+
+#endif // INLINER_HPP
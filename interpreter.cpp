@@ -0,0 +1,247 @@
+#include "interpreter.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// GCC and Clang can jump through a table of label addresses, which gives
+// every instruction handler its own indirect branch
+#if defined(__GNUC__) && !defined(FANC_NO_COMPUTED_GOTO)
+#define FANC_COMPUTED_GOTO 1
+#endif
+
+namespace {
+    using bytecode::Instruction;
+
+    // Registers of all active frames together, 256 MiB
+    const size_t MAX_REGISTERS = size_t(1) << 26;
+
+    struct CallFrame {
+        const Instruction *return_pc;
+        const bytecode::Function *function;
+        // Register index of the caller's frame
+        size_t base;
+        // Caller register receiving the result
+        int32_t result;
+    };
+
+    class Output {
+    public:
+        explicit Output(FILE *out) : out(out) {}
+        ~Output() { flush(); }
+
+        void line(const char *text, size_t size) {
+            if (buffer.size() + size + 1 > CAPACITY) flush();
+            buffer.append(text, size);
+            buffer.push_back('\n');
+        }
+
+        void number(int32_t value) {
+            char digits[12];
+            char *end = digits + sizeof(digits);
+            char *begin = end;
+            uint32_t magnitude = value < 0 ? 0u - static_cast<uint32_t>(value) : static_cast<uint32_t>(value);
+            do {
+                *--begin = static_cast<char>('0' + magnitude % 10);
+                magnitude /= 10;
+            } while (magnitude != 0);
+            if (value < 0) *--begin = '-';
+            line(begin, end - begin);
+        }
+
+        void flush() {
+            std::fwrite(buffer.data(), 1, buffer.size(), out);
+            std::fflush(out);
+            buffer.clear();
+        }
+
+    private:
+        static const size_t CAPACITY = 1 << 16;
+        FILE *out;
+        std::string buffer;
+    };
+
+    int32_t wrap(uint32_t value) {
+        return static_cast<int32_t>(value);
+    }
+
+    // sdiv without the overflow trap of INT_MIN / -1
+    int32_t divide(int32_t left, int32_t right) {
+        if (right == -1) return wrap(0u - static_cast<uint32_t>(left));
+        return left / right;
+    }
+}
+
+int runBytecode(const bytecode::Program &program, FILE *out) {
+    using namespace bytecode;
+    static const char DIVISION_ERROR[] = "Error division by zero";
+
+    Output output(out);
+    if (program.main < 0) return 0;
+
+    const Function *function = &program.functions[program.main];
+    std::vector<int32_t> stack(std::max<size_t>(1024, function->frame_size));
+    std::vector<CallFrame> calls;
+    int32_t *r = stack.data();
+    const Instruction *pc = function->code.data();
+
+#ifdef FANC_COMPUTED_GOTO
+    static const void *const dispatch_table[OPCODE_COUNT] = {
+        &&op_LOADK, &&op_MOVE, &&op_ADD, &&op_SUB, &&op_MUL, &&op_DIV,
+        &&op_ADDB, &&op_SUBB, &&op_MULB, &&op_DIVB, &&op_TRUNCB,
+        &&op_EQ, &&op_NE, &&op_LT, &&op_GT, &&op_LE, &&op_GE, &&op_NOT,
+        &&op_JUMP, &&op_JUMPZ, &&op_JUMPNZ, &&op_CALL, &&op_RET, &&op_RETVOID,
+        &&op_PRINT, &&op_PRINTI,
+    };
+#define TARGET(name) op_##name
+#define DISPATCH() goto *dispatch_table[pc->op]
+    DISPATCH();
+#else
+#define TARGET(name) case name
+#define DISPATCH() goto dispatch
+dispatch:
+    switch (pc->op) {
+#endif
+
+    TARGET(LOADK):
+        r[pc->a] = pc->b;
+        ++pc;
+        DISPATCH();
+    TARGET(MOVE):
+        r[pc->a] = r[pc->b];
+        ++pc;
+        DISPATCH();
+    TARGET(ADD):
+        r[pc->a] = wrap(static_cast<uint32_t>(r[pc->b]) + static_cast<uint32_t>(r[pc->c]));
+        ++pc;
+        DISPATCH();
+    TARGET(SUB):
+        r[pc->a] = wrap(static_cast<uint32_t>(r[pc->b]) - static_cast<uint32_t>(r[pc->c]));
+        ++pc;
+        DISPATCH();
+    TARGET(MUL):
+        r[pc->a] = wrap(static_cast<uint32_t>(r[pc->b]) * static_cast<uint32_t>(r[pc->c]));
+        ++pc;
+        DISPATCH();
+    TARGET(DIV):
+        if (r[pc->c] == 0) goto division_by_zero;
+        r[pc->a] = divide(r[pc->b], r[pc->c]);
+        ++pc;
+        DISPATCH();
+    TARGET(ADDB):
+        r[pc->a] = (r[pc->b] + r[pc->c]) & 255;
+        ++pc;
+        DISPATCH();
+    TARGET(SUBB):
+        r[pc->a] = (r[pc->b] - r[pc->c]) & 255;
+        ++pc;
+        DISPATCH();
+    TARGET(MULB):
+        r[pc->a] = (r[pc->b] * r[pc->c]) & 255;
+        ++pc;
+        DISPATCH();
+    TARGET(DIVB):
+        if (r[pc->c] == 0) goto division_by_zero;
+        r[pc->a] = (static_cast<uint32_t>(r[pc->b]) / static_cast<uint32_t>(r[pc->c])) & 255;
+        ++pc;
+        DISPATCH();
+    TARGET(TRUNCB):
+        r[pc->a] = r[pc->b] & 255;
+        ++pc;
+        DISPATCH();
+    TARGET(EQ):
+        r[pc->a] = r[pc->b] == r[pc->c];
+        ++pc;
+        DISPATCH();
+    TARGET(NE):
+        r[pc->a] = r[pc->b] != r[pc->c];
+        ++pc;
+        DISPATCH();
+    TARGET(LT):
+        r[pc->a] = r[pc->b] < r[pc->c];
+        ++pc;
+        DISPATCH();
+    TARGET(GT):
+        r[pc->a] = r[pc->b] > r[pc->c];
+        ++pc;
+        DISPATCH();
+    TARGET(LE):
+        r[pc->a] = r[pc->b] <= r[pc->c];
+        ++pc;
+        DISPATCH();
+    TARGET(GE):
+        r[pc->a] = r[pc->b] >= r[pc->c];
+        ++pc;
+        DISPATCH();
+    TARGET(NOT):
+        r[pc->a] = r[pc->b] ^ 1;
+        ++pc;
+        DISPATCH();
+    TARGET(JUMP):
+        pc = function->code.data() + pc->a;
+        DISPATCH();
+    TARGET(JUMPZ):
+        pc = r[pc->a] == 0 ? function->code.data() + pc->b : pc + 1;
+        DISPATCH();
+    TARGET(JUMPNZ):
+        pc = r[pc->a] != 0 ? function->code.data() + pc->b : pc + 1;
+        DISPATCH();
+    TARGET(CALL): {
+        const Function *callee = &program.functions[pc->b];
+        size_t base = static_cast<size_t>(r - stack.data());
+        size_t callee_base = base + pc->a;
+        if (callee_base + callee->frame_size > stack.size()) {
+            if (callee_base + callee->frame_size > MAX_REGISTERS) {
+                output.flush();
+                std::fputs("stack overflow\n", stderr);
+                return 1;
+            }
+            stack.resize(std::min(MAX_REGISTERS, std::max(stack.size() * 2, callee_base + callee->frame_size)));
+        }
+        calls.push_back({pc + 1, function, base, pc->a});
+        function = callee;
+        r = stack.data() + callee_base;
+        pc = callee->code.data();
+        DISPATCH();
+    }
+    TARGET(RET): {
+        int32_t value = r[pc->a];
+        if (calls.empty()) return 0;
+        const CallFrame &frame = calls.back();
+        r = stack.data() + frame.base;
+        r[frame.result] = value;
+        pc = frame.return_pc;
+        function = frame.function;
+        calls.pop_back();
+        DISPATCH();
+    }
+    TARGET(RETVOID): {
+        if (calls.empty()) return 0;
+        const CallFrame &frame = calls.back();
+        r = stack.data() + frame.base;
+        pc = frame.return_pc;
+        function = frame.function;
+        calls.pop_back();
+        DISPATCH();
+    }
+    TARGET(PRINT): {
+        const std::string &text = program.strings[pc->a];
+        output.line(text.data(), text.size());
+        ++pc;
+        DISPATCH();
+    }
+    TARGET(PRINTI):
+        output.number(r[pc->a]);
+        ++pc;
+        DISPATCH();
+
+#ifndef FANC_COMPUTED_GOTO
+    default:
+        return 1;
+    }
+#endif
+
+division_by_zero:
+    output.line(DIVISION_ERROR, sizeof(DIVISION_ERROR) - 1);
+    return 0;
+}
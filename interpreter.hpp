@@ -0,0 +1,14 @@
+#ifndef INTERPRETER_HPP
+#define INTERPRETER_HPP
+
+#include <cstdio>
+#include "bytecode.hpp"
+
+/* Runs a bytecode program from its main function.
+   Output goes to out through a buffer of its own. A division by zero prints
+   the error message and ends the program with status 0, like the exit(0) of
+   the generated code. Returns the exit status: 0, or 1 when the call stack
+   outgrows its limit. */
+int runBytecode(const bytecode::Program &program, FILE *out);
+
+#endif // INTERPRETER_HPP
@@ -0,0 +1,162 @@
+#include "ir_text.hpp"
+#include <cctype>
+#include <sstream>
+#include <unordered_set>
+
+namespace ir {
+
+    bool startsWith(const std::string &text, const std::string &prefix) {
+        return text.compare(0, prefix.size(), prefix) == 0;
+    }
+
+    bool endsWith(const std::string &text, const std::string &suffix) {
+        return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    std::string definedName(const std::string &line) {
+        if (line.empty() || line[0] != '%') return "";
+        size_t equals = line.find(" = ");
+        return equals == std::string::npos ? "" : line.substr(0, equals);
+    }
+
+    bool isConstant(const std::string &value) {
+        size_t digits = !value.empty() && value[0] == '-' ? 1 : 0;
+        return value.size() > digits && value.find_first_not_of("0123456789", digits) == std::string::npos;
+    }
+
+    bool isLabel(const std::string &line) {
+        return !line.empty() && line.back() == ':' && line.find(' ') == std::string::npos;
+    }
+
+    bool isTerminator(const std::string &line) {
+        return startsWith(line, "br ") || startsWith(line, "ret ") || line == "unreachable";
+    }
+
+    bool isCall(const std::string &instruction) {
+        return startsWith(instruction, "call ") || startsWith(instruction, "tail call ") ||
+               startsWith(instruction, "musttail call ");
+    }
+
+    bool isNameChar(char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.';
+    }
+
+    void Substitution::add(const std::string &name, const std::string &value) {
+        values[name] = value;
+    }
+
+    std::string Substitution::resolve(std::string value) const {
+        for (auto found = values.find(value); found != values.end(); found = values.find(value)) {
+            value = found->second;
+        }
+        return value;
+    }
+
+    std::string Substitution::apply(const std::string &line) const {
+        if (values.empty()) return line;
+        std::string result;
+        size_t copied = 0;
+        forEachName(line, [&](size_t begin, size_t end) {
+            std::string name = line.substr(begin, end - begin);
+            if (!values.count(name)) return;
+            result.append(line, copied, begin - copied);
+            result += resolve(name);
+            copied = end;
+        });
+        result.append(line, copied, std::string::npos);
+        return result;
+    }
+
+    std::vector<std::string> labelOperands(const std::string &line) {
+        std::vector<std::string> labels;
+        for (size_t at = line.find("label %"); at != std::string::npos; at = line.find("label %", at + 7)) {
+            size_t end = at + 7;
+            while (end < line.size() && isNameChar(line[end])) ++end;
+            labels.push_back(line.substr(at + 7, end - at - 7));
+        }
+        return labels;
+    }
+
+    std::string retarget(const std::string &line, const std::string &from, const std::string &to) {
+        std::string result;
+        size_t copied = 0;
+        for (size_t at = line.find("label %"); at != std::string::npos; at = line.find("label %", at + 7)) {
+            size_t end = at + 7;
+            while (end < line.size() && isNameChar(line[end])) ++end;
+            if (line.compare(at + 7, end - at - 7, from) != 0) continue;
+            result.append(line, copied, at + 7 - copied);
+            result += to;
+            copied = end;
+        }
+        result.append(line, copied, std::string::npos);
+        return result;
+    }
+
+    std::unordered_map<std::string, int> labelReferences(const std::vector<std::string> &lines) {
+        std::unordered_map<std::string, int> references;
+        for (const auto &line : lines) {
+            for (const auto &label : labelOperands(line)) {
+                ++references[label];
+            }
+        }
+        return references;
+    }
+
+    std::vector<Loop> findLoops(const std::vector<std::string> &lines) {
+        std::unordered_map<std::string, size_t> labels;
+        std::unordered_map<std::string, size_t> index;
+        std::vector<Loop> loops;
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (isLabel(lines[i])) {
+                labels[lines[i].substr(0, lines[i].size() - 1)] = i;
+                continue;
+            }
+            if (!startsWith(lines[i], "br ")) continue;
+            for (const auto &target : labelOperands(lines[i])) {
+                auto label = labels.find(target);
+                if (label == labels.end()) continue;
+                auto known = index.find(target);
+                if (known == index.end()) {
+                    index[target] = loops.size();
+                    loops.push_back({target, label->second, i});
+                } else {
+                    loops[known->second].end = i;
+                }
+            }
+        }
+        return loops;
+    }
+
+    bool singleEntry(const std::vector<std::string> &lines, const Loop &loop) {
+        std::unordered_set<std::string> inside;
+        for (size_t i = loop.begin + 1; i <= loop.end; ++i) {
+            if (isLabel(lines[i])) inside.insert(lines[i].substr(0, lines[i].size() - 1));
+        }
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (i >= loop.begin && i <= loop.end) continue;
+            for (const auto &target : labelOperands(lines[i])) {
+                if (inside.count(target)) return false;
+            }
+        }
+        return true;
+    }
+
+    std::vector<std::string> splitLines(const std::string &text) {
+        std::vector<std::string> lines;
+        std::istringstream in(text);
+        std::string line;
+        while (std::getline(in, line)) {
+            lines.push_back(line);
+        }
+        return lines;
+    }
+
+    std::string joinLines(const std::vector<std::string> &lines) {
+        std::string text;
+        for (const auto &line : lines) {
+            text += line;
+            text += '\n';
+        }
+        return text;
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef IR_TEXT_HPP
+#define IR_TEXT_HPP
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Helpers of the passes that rewrite the IR text of one function as
+   CodeGenerator emits it: "define ... {", unindented instructions,
+   "name:" labels, "}". Value and label names are unique within a
+   function. */
+namespace ir {
+
+    bool startsWith(const std::string &text, const std::string &prefix);
+    bool endsWith(const std::string &text, const std::string &suffix);
+
+    // "%name" of "%name = ...", empty for other lines
+    std::string definedName(const std::string &line);
+    // An integer literal
+    bool isConstant(const std::string &value);
+    bool isLabel(const std::string &line);
+    bool isTerminator(const std::string &line);
+    // A call instruction, or the right-hand side of one, with or without a tail marker
+    bool isCall(const std::string &instruction);
+
+    bool isNameChar(char c);
+
+    // Calls f(begin, end) on the position of every "%name" token of the line
+    template <typename F>
+    void forEachName(const std::string &line, F f) {
+        for (size_t i = 0; i < line.size(); ++i) {
+            if (line[i] != '%' || i + 1 == line.size() || !isNameChar(line[i + 1])) continue;
+            size_t end = i + 1;
+            while (end < line.size() && isNameChar(line[end])) ++end;
+            f(i, end);
+            i = end - 1;
+        }
+    }
+
+    // Values replaced by other values or constants
+    class Substitution {
+    public:
+        void add(const std::string &name, const std::string &value);
+        // Follows chains of replacements
+        std::string resolve(std::string value) const;
+        // The line with every replaced name substituted
+        std::string apply(const std::string &line) const;
+
+    private:
+        std::unordered_map<std::string, std::string> values;
+    };
+
+    // The "label %name" operands of a line, in order
+    std::vector<std::string> labelOperands(const std::string &line);
+    // The line with its "label %from" operands changed to "label %to"
+    std::string retarget(const std::string &line, const std::string &from, const std::string &to);
+
+    // How many "label %name" operands refer to every label
+    std::unordered_map<std::string, int> labelReferences(const std::vector<std::string> &lines);
+
+    // CodeGenerator emits structured code: a loop is the run of lines from a
+    // label some later branch jumps back to, up to the last such branch
+    struct Loop {
+        std::string header;
+        size_t begin;  // the header's label
+        size_t end;    // the last branch back to it
+    };
+    std::vector<Loop> findLoops(const std::vector<std::string> &lines);
+    // No branch from outside the loop enters it anywhere but at the header
+    bool singleEntry(const std::vector<std::string> &lines, const Loop &loop);
+
+    std::vector<std::string> splitLines(const std::string &text);
+    std::string joinLines(const std::vector<std::string> &lines);
+}
+
+#endif // IR_TEXT_HPP
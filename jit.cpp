@@ -0,0 +1,86 @@
+#include "jit.hpp"
+
+#ifdef FANC_WITH_LLVM
+
+#include <cstdio>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+
+template <typename T>
+static bool failed(llvm::Expected<T> &value, std::ostream &errors) {
+    if (value) return false;
+    errors << "jit: " << llvm::toString(value.takeError()) << std::endl;
+    return true;
+}
+
+static bool failed(llvm::Error error, std::ostream &errors) {
+    if (!error) return false;
+    errors << "jit: " << llvm::toString(std::move(error)) << std::endl;
+    return true;
+}
+
+int runJit(const std::string &ir, std::ostream &errors) {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    llvm::InitializeNativeTargetAsmParser();
+
+    auto context = std::make_unique<llvm::LLVMContext>();
+    llvm::SMDiagnostic diagnostic;
+    std::unique_ptr<llvm::Module> module = llvm::parseIR(llvm::MemoryBufferRef(ir, "fanc"), diagnostic, *context);
+    if (!module) {
+        std::string message;
+        llvm::raw_string_ostream stream(message);
+        diagnostic.print("jit", stream);
+        errors << stream.str();
+        return 1;
+    }
+
+    // Programs without output carry no library
+    bool buffered = module->getFunction(".flush") != nullptr;
+
+    auto jit = llvm::orc::LLJITBuilder().create();
+    if (failed(jit, errors)) return 1;
+    llvm::orc::JITDylib &library = (*jit)->getMainJITDylib();
+
+    // write, exit and memcpy come from the process itself
+    auto process = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        (*jit)->getDataLayout().getGlobalPrefix());
+    if (failed(process, errors)) return 1;
+    library.addGenerator(std::move(*process));
+
+    if (failed((*jit)->addIRModule(llvm::orc::ThreadSafeModule(std::move(module), std::move(context))), errors)) {
+        return 1;
+    }
+
+    auto main = (*jit)->lookup("main");
+    if (failed(main, errors)) return 1;
+    auto entry = llvm::jitTargetAddressToFunction<void (*)()>(main->getAddress());
+    void (*flush)() = nullptr;
+    if (buffered) {
+        auto symbol = (*jit)->lookup(".flush");
+        if (failed(symbol, errors)) return 1;
+        flush = llvm::jitTargetAddressToFunction<void (*)()>(symbol->getAddress());
+    }
+
+    // The library of the IR buffers the output itself and writes it to the
+    // file descriptor, after what the compiler may have left in stdout
+    std::fflush(stdout);
+    entry();
+    if (flush) flush();
+    return 0;
+}
+
+#else
+
+int runJit(const std::string &, std::ostream &errors) {
+    errors << "jit: this compiler was built without LLVM (make LLVM=1)" << std::endl;
+    return 1;
+}
+
+#endif // FANC_WITH_LLVM
@@ -0,0 +1,15 @@
+#ifndef JIT_HPP
+#define JIT_HPP
+
+#include <iostream>
+#include <string>
+
+/* In-process execution of generated IR with an LLVM ORC LLJIT.
+   The IR is parsed from memory, print and printi are bound to functions of
+   the compiler itself instead of the definitions in the IR, and main is
+   called directly. Available when the compiler is built with FANC_WITH_LLVM
+   (make LLVM=1); otherwise runJit only reports that.
+   Returns 0 once main returns, or writes the problem to errors and returns 1. */
+int runJit(const std::string &ir, std::ostream &errors);
+
+#endif // JIT_HPP
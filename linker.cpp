@@ -0,0 +1,154 @@
+#include "linker.hpp"
+#include "code_generator.hpp"
+#include "output.hpp"
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+namespace {
+    enum class LineKind {
+        OTHER,
+        // declare <type> @name(<params>)
+        DECLARE,
+        // define <type> @name(<params>) {
+        DEFINE,
+        // @name = external constant <type>
+        EXTERNAL,
+        // @name = constant <type> <value>
+        CONSTANT
+    };
+
+    // A top-level symbol mentioned by a line of generated IR
+    struct Symbol {
+        LineKind kind = LineKind::OTHER;
+        std::string name;
+        // "<return> (<params>)" for functions, the array type for constants
+        std::string type;
+    };
+
+    struct Definition {
+        std::string type;
+        std::string origin;
+    };
+
+    Symbol functionSymbol(const std::string &line, LineKind kind, size_t keyword) {
+        Symbol symbol;
+        size_t at = line.find(" @", keyword);
+        size_t open = line.find('(', at);
+        size_t close = line.rfind(')');
+        if (at == std::string::npos || open == std::string::npos || close == std::string::npos || close < open) {
+            return symbol;
+        }
+        symbol.kind = kind;
+        symbol.name = line.substr(at + 2, open - at - 2);
+        symbol.type = line.substr(keyword, at - keyword) + " " + line.substr(open, close - open + 1);
+        return symbol;
+    }
+
+    Symbol globalSymbol(const std::string &line) {
+        Symbol symbol;
+        size_t equals = line.find(" = ");
+        if (equals == std::string::npos) return symbol;
+        std::string rest = line.substr(equals + 3);
+        if (rest.rfind("external constant ", 0) == 0) {
+            symbol.kind = LineKind::EXTERNAL;
+            symbol.type = rest.substr(18);
+        } else if (rest.rfind("constant ", 0) == 0) {
+            symbol.kind = LineKind::CONSTANT;
+            symbol.type = rest.substr(9, rest.find(" c\"") - 9);
+        } else {
+            return symbol;
+        }
+        symbol.name = line.substr(1, equals - 1);
+        return symbol;
+    }
+
+    Symbol classify(const std::string &line) {
+        if (line.rfind("declare ", 0) == 0) return functionSymbol(line, LineKind::DECLARE, 8);
+        if (line.rfind("define ", 0) == 0) return functionSymbol(line, LineKind::DEFINE, 7);
+        if (line.rfind("@", 0) == 0) return globalSymbol(line);
+        return Symbol();
+    }
+
+    std::vector<std::string> splitLines(const std::string &text) {
+        std::vector<std::string> lines;
+        std::istringstream in(text);
+        std::string line;
+        while (std::getline(in, line)) {
+            lines.push_back(line);
+        }
+        return lines;
+    }
+}
+
+int linkModules(const std::vector<std::string> &paths, std::ostream &out, std::ostream &errors) {
+    output::CodeBuffer runtime;
+    CodeGenerator::emitRuntime(runtime);
+    std::ostringstream runtime_text;
+    runtime_text << runtime;
+
+    // Everything the library and the modules define
+    std::unordered_map<std::string, Definition> definitions;
+    for (const auto &line : splitLines(runtime_text.str())) {
+        Symbol symbol = classify(line);
+        if (symbol.kind != LineKind::OTHER) definitions[symbol.name] = {symbol.type, "the library"};
+    }
+
+    std::vector<std::vector<std::string>> modules;
+    for (const auto &path : paths) {
+        std::ifstream in(path);
+        if (!in) {
+            errors << "link error: cannot read " << path << std::endl;
+            return 1;
+        }
+        std::stringstream content;
+        content << in.rdbuf();
+        modules.push_back(splitLines(content.str()));
+
+        for (const auto &line : modules.back()) {
+            Symbol symbol = classify(line);
+            if (symbol.kind != LineKind::DEFINE && symbol.kind != LineKind::CONSTANT) continue;
+            auto found = definitions.find(symbol.name);
+            if (found != definitions.end()) {
+                errors << "link error: " << symbol.name << " is defined in both " << found->second.origin
+                       << " and " << path << std::endl;
+                return 1;
+            }
+            definitions[symbol.name] = {symbol.type, path};
+        }
+    }
+
+    auto main = definitions.find("main");
+    if (main == definitions.end() || main->second.type != "void ()") {
+        errors << "link error: no module defines void main()" << std::endl;
+        return 1;
+    }
+
+    // The library first, then every module without its declarations
+    std::ostringstream program;
+    program << runtime_text.str();
+    for (size_t i = 0; i < modules.size(); ++i) {
+        for (const auto &line : modules[i]) {
+            Symbol symbol = classify(line);
+            if (symbol.kind == LineKind::DECLARE || symbol.kind == LineKind::EXTERNAL) {
+                auto found = definitions.find(symbol.name);
+                if (found == definitions.end()) {
+                    errors << "link error: " << symbol.name << " is used in " << paths[i]
+                           << " but no module defines it" << std::endl;
+                    return 1;
+                }
+                if (found->second.type != symbol.type) {
+                    errors << "link error: " << symbol.name << " is declared as " << symbol.type << " in "
+                           << paths[i] << " but defined as " << found->second.type << " in "
+                           << found->second.origin << std::endl;
+                    return 1;
+                }
+            } else if (!line.empty()) {
+                program << line << std::endl;
+            }
+        }
+    }
+
+    out << program.str();
+    return 0;
+}
@@ -0,0 +1,19 @@
+#ifndef LINKER_HPP
+#define LINKER_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+/* Link step of separate compilation.
+   Merges the .ll files of FanC modules into one program: the library
+   (print, printi, the output buffer, ...) is emitted once, every module contributes its
+   functions and strings, and the declarations a module made for its imports
+   are resolved against the definitions of the other modules. Every module
+   declaration must match the definition's types, every function may be
+   defined once, and one of the modules must define main.
+   Writes the program to out and returns 0, or writes the first problem to
+   errors and returns 1. */
+int linkModules(const std::vector<std::string> &paths, std::ostream &out, std::ostream &errors);
+
+#endif // LINKER_HPP
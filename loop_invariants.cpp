@@ -0,0 +1,128 @@
+#include "loop_invariants.hpp"
+#include "ir_text.hpp"
+#include "statistics.hpp"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace ir;
+
+namespace {
+    bool isHoistable(const std::string &instruction) {
+        static const char *const pure[] = {"add ", "sub ", "mul ", "and ", "or ", "xor ",
+                                           "icmp ", "zext ", "sext ", "trunc "};
+        for (const char *prefix : pure) {
+            if (startsWith(instruction, prefix)) return true;
+        }
+        return false;
+    }
+}
+
+std::string hoistInvariants(const std::string &function, Statistics *statistics) {
+    // Phis name the blocks they are entered from, a preheader would be a new one
+    if (function.find(" = phi ") != std::string::npos) return function;
+
+    std::vector<std::string> lines = splitLines(function);
+    unsigned long hoisted = 0, preheaders = 0;
+
+    std::unordered_set<std::string> done;
+    for (;;) {
+        // The innermost loop not done yet is the shortest
+        std::vector<Loop> loops = findLoops(lines);
+        const Loop *next = nullptr;
+        for (const auto &loop : loops) {
+            if (done.count(loop.header)) continue;
+            if (!next || loop.end - loop.begin < next->end - next->begin) next = &loop;
+        }
+        if (!next) break;
+        Loop loop = *next;
+        done.insert(loop.header);
+        if (!singleEntry(lines, loop)) continue;
+
+        std::unordered_set<std::string> stored, defined;
+        for (size_t i = loop.begin; i <= loop.end; ++i) {
+            if (startsWith(lines[i], "store ")) stored.insert(lines[i].substr(lines[i].rfind("* ") + 2));
+            std::string name = definedName(lines[i]);
+            if (!name.empty()) defined.insert(name);
+        }
+
+        // In order, so the operands of an instruction are decided before it
+        std::unordered_set<std::string> invariant;
+        std::vector<std::string> moved, body;
+        for (size_t i = loop.begin; i <= loop.end; ++i) {
+            const std::string &line = lines[i];
+            std::string name = definedName(line);
+            std::string rest = name.empty() ? "" : line.substr(name.size() + 3);
+            bool hoist = false;
+            if (startsWith(rest, "alloca ")) {
+                // Stored to right away, so one slot for all iterations holds the same values
+                hoist = i + 1 <= loop.end && startsWith(lines[i + 1], "store ") && endsWith(lines[i + 1], "* " + name);
+            } else if (startsWith(rest, "load ")) {
+                std::string slot = rest.substr(rest.rfind("* ") + 2);
+                hoist = slot[0] == '%' && !stored.count(slot) && !defined.count(slot);
+            } else if (isHoistable(rest)) {
+                hoist = true;
+                forEachName(line, [&](size_t begin, size_t end) {
+                    std::string operand = line.substr(begin, end - begin);
+                    if (begin != 0 && defined.count(operand) && !invariant.count(operand)) hoist = false;
+                });
+            }
+            if (hoist) {
+                invariant.insert(name);
+                moved.push_back(line);
+            } else {
+                body.push_back(line);
+            }
+        }
+        if (moved.empty()) continue;
+
+        // Entries into the loop go through the preheader, the back edges do not
+        std::string preheader = loop.header + ".preheader";
+        std::vector<std::string> result;
+        for (size_t i = 0; i < loop.begin; ++i) {
+            result.push_back(retarget(lines[i], loop.header, preheader));
+        }
+        result.push_back(preheader + ":");
+        result.insert(result.end(), moved.begin(), moved.end());
+        result.push_back("br label %" + loop.header);
+        result.insert(result.end(), body.begin(), body.end());
+        for (size_t i = loop.end + 1; i < lines.size(); ++i) {
+            result.push_back(retarget(lines[i], loop.header, preheader));
+        }
+        lines.swap(result);
+        hoisted += moved.size();
+        ++preheaders;
+    }
+
+    // Preheaders of inner loops left empty by the enclosing loop
+    std::unordered_map<std::string, std::string> empty;
+    for (size_t i = 0; i + 1 < lines.size(); ++i) {
+        if (isLabel(lines[i]) && endsWith(lines[i], ".preheader:") &&
+            lines[i + 1] == "br label %" + lines[i].substr(0, lines[i].size() - 11)) {
+            empty[lines[i].substr(0, lines[i].size() - 1)] = lines[i].substr(0, lines[i].size() - 11);
+        }
+    }
+    if (!empty.empty()) {
+        std::vector<std::string> result;
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (isLabel(lines[i]) && empty.count(lines[i].substr(0, lines[i].size() - 1))) {
+                ++i;
+                --preheaders;
+                continue;
+            }
+            std::string line = lines[i];
+            for (const auto &label : labelOperands(lines[i])) {
+                auto header = empty.find(label);
+                if (header != empty.end()) line = retarget(line, label, header->second);
+            }
+            result.push_back(line);
+        }
+        lines.swap(result);
+    }
+
+    if (statistics) {
+        statistics->add("loop invariant instructions hoisted", hoisted);
+        statistics->add("loop preheaders", preheaders);
+    }
+    return joinLines(lines);
+}
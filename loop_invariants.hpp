@@ -0,0 +1,25 @@
+#ifndef LOOP_INVARIANTS_HPP
+#define LOOP_INVARIANTS_HPP
+
+#include <string>
+
+class Statistics;
+
+/* Loop-invariant code motion over the IR text of one function (see
+   ir_text.hpp). CodeGenerator emits structured code, so a loop is the run
+   of lines from a label some later branch jumps back to, up to the last
+   such branch, entered only through that label. Computed the same way on
+   every iteration, and so moved into a preheader block in front of the
+   loop, are:
+   - loads of slots the loop never stores to
+   - allocas followed right away by a store to them, so the loop reuses
+     one slot instead of growing the stack every iteration (CodeGenerator
+     puts its own in the entry block already)
+   - arithmetic, comparisons and casts whose operands are constants or
+     come from outside the loop
+   None of them can trap, so they may run even when the loop body would
+   not have reached them; divisions stay where they are. Inner loops are
+   done first, and what they hoist may leave the enclosing loop as well. */
+std::string hoistInvariants(const std::string &function, Statistics *statistics);
+
+#endif // LOOP_INVARIANTS_HPP
@@ -1,33 +1,232 @@
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 #include <iostream>
-#include "output.hpp"
-#include "nodes.hpp"
-#include "semantic_analayzer_visitor.hpp"
-#include "code_generator.hpp"
-
-extern int yyparse();
-extern std::shared_ptr<ast::Node> program;
-
-int main() {
-    yyparse();
-    
-    if (!program) {
-        std::cerr << "Error: Failed to parse the program (AST root is null)." << std::endl;
+#include <iterator>
+#include <string>
+#include "fanc.hpp"
+#include "batch.hpp"
+#include "compile_server.hpp"
+#include "compile_cache.hpp"
+#include "incremental.hpp"
+#include "linker.hpp"
+#include "jit.hpp"
+#include "native.hpp"
+#include "module_interface.hpp"
+#include "statistics.hpp"
+#include <vector>
+
+// Reads the value of a numeric option: decimal digits only, at most max.
+// Otherwise reports it and returns false.
+template <typename Number>
+static bool parseCount(const std::string &option, const std::string &text, Number &value,
+                       unsigned long long max = UINT_MAX) {
+    errno = 0;
+    char *end = nullptr;
+    unsigned long long parsed = std::strtoull(text.c_str(), &end, 10);
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos || errno == ERANGE ||
+        parsed > max) {
+        std::cerr << "invalid value for " << option << ": " << text << std::endl;
+        return false;
+    }
+    value = static_cast<Number>(parsed);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    fanc::Options options;
+    // -j N: number of threads used inside the compiler (default: one per hardware thread)
+    options.jobs = 0;
+    // --batch <dir|list> [--out-dir DIR]: compile many sources in this process
+    std::string batch_input;
+    std::string out_dir;
+    // --serve SOCK: keep a compiler resident behind a UNIX socket
+    // --connect SOCK [--stop]: compile stdin on that server (or stop it)
+    std::string serve_socket;
+    std::string connect_socket;
+    bool stop_server = false;
+    // --cache DIR [--cache-size BYTES] [--cache-stats]: reuse earlier results
+    std::string cache_dir;
+    unsigned long long cache_size = 64ULL << 20;
+    bool cache_stats = false;
+    // --incremental STATE: recompile only the functions changed since the last
+    // compile of the program read from stdin (--cache-stats reports them)
+    std::string state_file;
+    // --module NAME [--emit-interface FILE] [--import FILE]...: compile stdin as
+    // one module of a larger program
+    std::string interface_file;
+    std::vector<std::string> import_files;
+    // --link FILE...: merge the .ll files of modules into a program
+    bool link = false;
+    // --run: execute the program read from stdin instead of printing its IR
+    bool run = false;
+    // --interpret: run it on the bytecode interpreter
+    bool interpret = false;
+    // -o FILE [-O0..-O3] [--runtime OBJ]: build a native executable instead;
+    // -O0 also turns off the optimizations of the compiler itself
+    std::string executable;
+    NativeOptions native;
+    // --unroll=N: instruction budget of an unrolled loop (--unroll=0 turns it off)
+    // --inline-threshold N: how much larger than a call its inlined copy may be
+    // --memoize: cache the results of pure recursive functions
+    // --stats: report what the optimizations removed or rewrote
+    bool stats = false;
+    // --backend asm: generate x86-64 assembly instead of LLVM IR (whole programs only)
+    std::string backend = "llvm";
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            if (!parseCount("-j", argv[++i], options.jobs)) return 1;
+        } else if (arg.rfind("-j", 0) == 0 && arg.size() > 2) {
+            if (!parseCount("-j", arg.substr(2), options.jobs)) return 1;
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batch_input = argv[++i];
+        } else if (arg == "--out-dir" && i + 1 < argc) {
+            out_dir = argv[++i];
+        } else if (arg == "--serve" && i + 1 < argc) {
+            serve_socket = argv[++i];
+        } else if (arg == "--connect" && i + 1 < argc) {
+            connect_socket = argv[++i];
+        } else if (arg == "--stop") {
+            stop_server = true;
+        } else if (arg == "--cache" && i + 1 < argc) {
+            cache_dir = argv[++i];
+        } else if (arg == "--cache-size" && i + 1 < argc) {
+            if (!parseCount("--cache-size", argv[++i], cache_size, ULLONG_MAX)) return 1;
+        } else if (arg == "--cache-stats") {
+            cache_stats = true;
+        } else if (arg == "--incremental" && i + 1 < argc) {
+            state_file = argv[++i];
+        } else if (arg == "--module" && i + 1 < argc) {
+            options.module = argv[++i];
+        } else if (arg == "--emit-interface" && i + 1 < argc) {
+            interface_file = argv[++i];
+        } else if (arg == "--import" && i + 1 < argc) {
+            import_files.push_back(argv[++i]);
+        } else if (arg == "--link") {
+            link = true;
+        } else if (arg == "--run") {
+            run = true;
+        } else if (arg == "--interpret") {
+            interpret = true;
+        } else if (arg == "-o" && i + 1 < argc) {
+            executable = argv[++i];
+        } else if (arg.size() == 3 && arg.compare(0, 2, "-O") == 0 && arg[2] >= '0' && arg[2] <= '3') {
+            native.opt_level = arg[2] - '0';
+            options.optimize = native.opt_level > 0;
+        } else if (arg == "--runtime" && i + 1 < argc) {
+            native.runtime_object = argv[++i];
+        } else if (arg.rfind("--unroll=", 0) == 0) {
+            if (!parseCount("--unroll", arg.substr(9), options.unroll)) return 1;
+        } else if (arg == "--inline-threshold" && i + 1 < argc) {
+            if (!parseCount("--inline-threshold", argv[++i], options.inline_threshold)) return 1;
+        } else if (arg == "--memoize") {
+            options.memoize = true;
+        } else if (arg == "--stats") {
+            stats = true;
+        } else if (arg == "--backend" && i + 1 < argc) {
+            backend = argv[++i];
+        } else if (arg[0] != '-') {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (backend == "asm") {
+        options.backend = fanc::Backend::ASM;
+    } else if (backend != "llvm") {
+        std::cerr << "unknown backend " << backend << std::endl;
+        return 1;
+    }
+    // Assembly is neither linked as modules nor run by the JIT
+    if (options.backend == fanc::Backend::ASM && (!options.module.empty() || link || run)) {
+        std::cerr << "the asm backend compiles whole programs only" << std::endl;
         return 1;
     }
 
-    // Phase 1: Semantic Analysis
-    // Ensures type safety and validity before code generation.
-    SemanticAnalayzerVisitor semantic_visitor; 
-    program->accept(semantic_visitor);
+    if (stats) {
+        options.statistics = std::make_shared<Statistics>();
+    }
+    if (!cache_dir.empty()) {
+        options.cache = std::make_shared<CompileCache>(cache_dir, cache_size);
+    }
 
-    // Phase 2: Code Generation
-    // Emits LLVM IR to the code buffer.
-    output::CodeBuffer buffer;
-    CodeGenerator code_gen_visitor(buffer);
-    program->accept(code_gen_visitor);
+    // Module names become part of LLVM global names
+    if (options.module.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_") != std::string::npos) {
+        std::cerr << "invalid module name " << options.module << std::endl;
+        return 1;
+    }
+    for (const auto& path : import_files) {
+        ModuleInterface interface;
+        if (!readInterface(path, interface)) {
+            std::cerr << "cannot read interface summary " << path << std::endl;
+            return 1;
+        }
+        options.imports.push_back(interface);
+    }
+
+    int status = 0;
+    if (link) {
+        status = linkModules(inputs, std::cout, std::cerr);
+    } else if (!batch_input.empty()) {
+        // The pool runs one source per thread, so every compilation itself is serial
+        fanc::Options per_source = options;
+        per_source.jobs = 1;
+        status = compileBatch(batch_input, out_dir, options.jobs, per_source, std::cout) == 0 ? 0 : 1;
+    } else if (!serve_socket.empty()) {
+        // Requests are spread over the workers, every compilation itself is serial
+        fanc::Options per_request = options;
+        per_request.jobs = 1;
+        status = serveCompiler(serve_socket, options.jobs, 64, per_request, std::cerr);
+    } else if (!connect_socket.empty() && stop_server) {
+        status = requestShutdown(connect_socket) ? 0 : 1;
+    } else if (interpret) {
+        std::string source((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
+        std::string diagnostics;
+        if (!fanc::interpret(source, options, diagnostics, status)) std::cout << diagnostics;
+    } else {
+        std::string source((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
+        fanc::Result result;
+        if (!connect_socket.empty()) {
+            if (!requestCompile(connect_socket, source, result)) {
+                std::cerr << "cannot reach compile server at " << connect_socket << std::endl;
+                return 1;
+            }
+        } else {
+            // The state describes a single program, so only this mode uses it
+            if (!state_file.empty()) {
+                options.incremental = std::make_shared<IncrementalState>(state_file);
+            }
+            options.external_runtime = !executable.empty();
+            result = fanc::compile(source, options);
+        }
 
-    // Output the generated code to stdout
-    std::cout << buffer;
-    
-    return 0;
-}
\ No newline at end of file
+        // Either the generated code or the error message goes to stdout
+        if (run && result.ok) {
+            status = runJit(result.ir, std::cerr);
+        } else if (!executable.empty() && result.ok && options.backend == fanc::Backend::ASM) {
+            status = assembleExecutable(result.ir, executable, native, std::cerr);
+        } else if (!executable.empty() && result.ok) {
+            status = buildExecutable(result.ir, executable, native, std::cerr);
+        } else {
+            std::cout << (result.ok ? result.ir : result.diagnostics);
+        }
+
+        if (result.ok && !options.module.empty() && !interface_file.empty() &&
+            !writeInterface(interface_file, result.interface)) {
+            std::cerr << "cannot write interface summary " << interface_file << std::endl;
+            status = 1;
+        }
+    }
+
+    if (options.statistics) {
+        options.statistics->report(std::cerr);
+    }
+    if (cache_stats && options.cache) {
+        options.cache->report(std::cerr);
+    }
+    if (cache_stats && options.incremental) {
+        options.incremental->report(std::cerr);
+    }
+    return status;
+}
@@ -0,0 +1,126 @@
+#include "module_interface.hpp"
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+
+static const char INTERFACE_MAGIC[] = {'F', 'N', 'C', 'I'};
+static const unsigned char INTERFACE_VERSION = 1;
+
+namespace {
+    void putNumber(std::string &out, uint32_t value, int bytes) {
+        for (int shift = 8 * (bytes - 1); shift >= 0; shift -= 8) {
+            out.push_back(static_cast<char>((value >> shift) & 0xff));
+        }
+    }
+
+    void putName(std::string &out, const std::string &name) {
+        putNumber(out, static_cast<uint32_t>(name.size()), 2);
+        out += name;
+    }
+
+    // Reads from a byte string, remembering whether it ever ran past the end
+    class Reader {
+    public:
+        Reader(const std::string &data, size_t position) : data(data), position(position), failed(false) {}
+
+        uint32_t number(int bytes) {
+            uint32_t value = 0;
+            for (int i = 0; i < bytes; ++i) {
+                if (position >= data.size()) {
+                    failed = true;
+                    return 0;
+                }
+                value = (value << 8) | static_cast<unsigned char>(data[position++]);
+            }
+            return value;
+        }
+
+        std::string name() {
+            size_t size = number(2);
+            if (failed || data.size() - position < size) {
+                failed = true;
+                return "";
+            }
+            position += size;
+            return data.substr(position - size, size);
+        }
+
+        ast::BuiltInType type() {
+            uint32_t value = number(1);
+            if (value > ast::BuiltInType::STRING) failed = true;
+            return static_cast<ast::BuiltInType>(value);
+        }
+
+        bool ok() const { return !failed; }
+        bool atEnd() const { return position == data.size(); }
+
+    private:
+        const std::string &data;
+        size_t position;
+        bool failed;
+    };
+}
+
+ModuleInterface describeModule(const std::string &module, const ast::Funcs &program) {
+    ModuleInterface interface;
+    interface.module = module;
+    for (const auto &function : program.funcs) {
+        FunctionSignature signature;
+        signature.name = function->id->value;
+        signature.return_type = function->return_type->type;
+        if (function->formals) {
+            for (const auto &formal : function->formals->formals) {
+                signature.arguments.push_back(formal->type->type);
+            }
+        }
+        interface.functions.push_back(signature);
+    }
+    return interface;
+}
+
+bool writeInterface(const std::string &path, const ModuleInterface &interface) {
+    std::string data(INTERFACE_MAGIC, sizeof(INTERFACE_MAGIC));
+    data.push_back(static_cast<char>(INTERFACE_VERSION));
+    putName(data, interface.module);
+    putNumber(data, static_cast<uint32_t>(interface.functions.size()), 4);
+    for (const auto &function : interface.functions) {
+        putName(data, function.name);
+        putNumber(data, function.return_type, 1);
+        putNumber(data, static_cast<uint32_t>(function.arguments.size()), 1);
+        for (auto argument : function.arguments) {
+            putNumber(data, argument, 1);
+        }
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << data;
+    return static_cast<bool>(out);
+}
+
+bool readInterface(const std::string &path, ModuleInterface &interface) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    if (data.compare(0, sizeof(INTERFACE_MAGIC), INTERFACE_MAGIC, sizeof(INTERFACE_MAGIC)) != 0) return false;
+    Reader reader(data, sizeof(INTERFACE_MAGIC));
+    if (reader.number(1) != INTERFACE_VERSION) return false;
+
+    ModuleInterface result;
+    result.module = reader.name();
+    uint32_t count = reader.number(4);
+    for (uint32_t i = 0; i < count && reader.ok(); ++i) {
+        FunctionSignature function;
+        function.name = reader.name();
+        function.return_type = reader.type();
+        uint32_t arguments = reader.number(1);
+        for (uint32_t j = 0; j < arguments && reader.ok(); ++j) {
+            function.arguments.push_back(reader.type());
+        }
+        result.functions.push_back(function);
+    }
+    if (!reader.ok() || !reader.atEnd()) return false;
+
+    interface = result;
+    return true;
+}
@@ -0,0 +1,36 @@
+#ifndef MODULE_INTERFACE_HPP
+#define MODULE_INTERFACE_HPP
+
+#include <string>
+#include <vector>
+#include "nodes.hpp"
+
+/* Interface summary of a separately compiled FanC module: the signatures of
+   the functions it defines. Other modules import the summary to check their
+   calls, the module itself is linked from its .ll file.
+   On disk the summary is a compact binary file:
+       "FNCI" | format version (1 byte) | module name | function count (4 bytes)
+   followed by one record per function:
+       name | return type (1 byte) | argument count (1 byte) | argument types (1 byte each)
+   Names are a 2-byte length followed by the bytes; every number is big endian. */
+
+struct FunctionSignature {
+    std::string name;
+    ast::BuiltInType return_type;
+    std::vector<ast::BuiltInType> arguments;
+};
+
+struct ModuleInterface {
+    std::string module;
+    std::vector<FunctionSignature> functions;
+};
+
+// Signatures of every function the program defines, in source order
+ModuleInterface describeModule(const std::string &module, const ast::Funcs &program);
+
+bool writeInterface(const std::string &path, const ModuleInterface &interface);
+
+// Returns false if the file is missing or is not an interface summary
+bool readInterface(const std::string &path, ModuleInterface &interface);
+
+#endif // MODULE_INTERFACE_HPP
@@ -0,0 +1,123 @@
+#include "native.hpp"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+    // Runs a tool without a shell and waits for it; true if it exited with 0
+    bool runTool(const std::vector<std::string> &arguments, std::ostream &errors) {
+        std::vector<char *> argv;
+        for (const auto &argument : arguments) {
+            argv.push_back(const_cast<char *>(argument.c_str()));
+        }
+        argv.push_back(nullptr);
+
+        pid_t child = fork();
+        if (child < 0) {
+            errors << "native: cannot start " << arguments[0] << std::endl;
+            return false;
+        }
+        if (child == 0) {
+            execvp(argv[0], argv.data());
+            _exit(127);
+        }
+
+        int status = 0;
+        while (waitpid(child, &status, 0) < 0) {
+        }
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) return true;
+        errors << "native: " << arguments[0]
+               << (WIFEXITED(status) && WEXITSTATUS(status) == 127 ? " was not found" : " failed") << std::endl;
+        return false;
+    }
+
+    std::string defaultRuntime() {
+        std::error_code error;
+        fs::path executable = fs::read_symlink("/proc/self/exe", error);
+        return (executable.parent_path() / "runtime" / "fanc_runtime.o").string();
+    }
+
+    // Temporary directory removed with everything in it when leaving the scope
+    class WorkDirectory {
+    public:
+        WorkDirectory() {
+            std::string pattern = (fs::temp_directory_path() / "hw5-XXXXXX").string();
+            if (mkdtemp(&pattern[0])) path = pattern;
+        }
+        ~WorkDirectory() {
+            std::error_code error;
+            if (!path.empty()) fs::remove_all(path, error);
+        }
+        fs::path path;
+    };
+
+    // Finds the runtime object and checks the work directory exists
+    bool prepare(const NativeOptions &options, const WorkDirectory &work, std::string &runtime, std::ostream &errors) {
+        runtime = options.runtime_object.empty() ? defaultRuntime() : options.runtime_object;
+        if (!fs::exists(runtime)) {
+            errors << "native: runtime object " << runtime << " is missing" << std::endl;
+            return false;
+        }
+        if (work.path.empty()) {
+            errors << "native: cannot create a temporary directory" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool writeFile(const std::string &path, const std::string &contents, std::ostream &errors) {
+        std::ofstream out(path);
+        out << contents;
+        if (!out) {
+            errors << "native: cannot write " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool link(const std::string &object, const std::string &runtime, const std::string &output,
+              const NativeOptions &options, std::ostream &errors) {
+        // --wrap=main lets the runtime turn FanC's void main into a C main
+        return runTool({options.cc, object, runtime, "-Wl,--wrap=main", "-o", output}, errors);
+    }
+}
+
+int buildExecutable(const std::string &ir, const std::string &output, const NativeOptions &options,
+                    std::ostream &errors) {
+    std::string runtime;
+    WorkDirectory work;
+    if (!prepare(options, work, runtime, errors)) return 1;
+    std::string source = (work.path / "program.ll").string();
+    std::string optimized = (work.path / "program.bc").string();
+    std::string object = (work.path / "program.o").string();
+    if (!writeFile(source, ir, errors)) return 1;
+
+    std::string level = "-O" + std::to_string(options.opt_level);
+    std::string input = source;
+    if (options.opt_level > 0) {
+        if (!runTool({options.opt, level, source, "-o", optimized}, errors)) return 1;
+        input = optimized;
+    }
+    if (!runTool({options.llc, level, "-filetype=obj", "-relocation-model=pic", input, "-o", object}, errors)) {
+        return 1;
+    }
+    return link(object, runtime, output, options, errors) ? 0 : 1;
+}
+
+int assembleExecutable(const std::string &assembly, const std::string &output, const NativeOptions &options,
+                       std::ostream &errors) {
+    std::string runtime;
+    WorkDirectory work;
+    if (!prepare(options, work, runtime, errors)) return 1;
+    std::string source = (work.path / "program.s").string();
+    std::string object = (work.path / "program.o").string();
+    if (!writeFile(source, assembly, errors)) return 1;
+
+    if (!runTool({options.as, source, "-o", object}, errors)) return 1;
+    return link(object, runtime, output, options, errors) ? 0 : 1;
+}
@@ -0,0 +1,34 @@
+#ifndef NATIVE_HPP
+#define NATIVE_HPP
+
+#include <iostream>
+#include <string>
+
+/* Ahead-of-time compilation of generated code into a native executable.
+   IR must have been generated with an external runtime. It is optimized
+   with opt (skipped at level 0), turned into an object file by llc and
+   linked with the prebuilt runtime object by the C compiler driver.
+   Output of the asm backend only goes through the assembler. */
+
+struct NativeOptions {
+    // Optimization level passed to opt and llc (0-3)
+    int opt_level = 2;
+    // Prebuilt runtime/fanc_runtime.c; empty means runtime/fanc_runtime.o
+    // next to the hw5 executable
+    std::string runtime_object;
+    // Tools, looked up in PATH
+    std::string opt = "opt";
+    std::string llc = "llc";
+    std::string as = "as";
+    std::string cc = "cc";
+};
+
+// Writes the executable to output; returns 0, or writes the problem to errors and returns 1
+int buildExecutable(const std::string &ir, const std::string &output, const NativeOptions &options,
+                    std::ostream &errors);
+
+// Same for the assembly of the asm backend; the optimization level does not apply
+int assembleExecutable(const std::string &assembly, const std::string &output, const NativeOptions &options,
+                       std::ostream &errors);
+
+#endif // NATIVE_HPP
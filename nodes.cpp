@@ -1,16 +1,29 @@
 #include "nodes.hpp"
+#include "output.hpp"
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 #include <string>
 #include <utility>
 
-extern int yylineno;
-
 namespace ast {
 
-    Node::Node() : line(yylineno) {}
+    thread_local int parsing_line = 1;
+
+    Node::Node() : line(parsing_line) {}
+
+    // A literal that does not fit an int is a lexical error; larger bytes
+    // are reported by the semantic analysis with their value
+    static int literalValue(const char *str) {
+        errno = 0;
+        long long value = std::strtoll(str, nullptr, 10);
+        if (errno == ERANGE || value > INT_MAX) output::errorLex(parsing_line);
+        return static_cast<int>(value);
+    }
 
-    Num::Num(const char *str) : Exp(), value(std::stoi(str)) {}
+    Num::Num(const char *str) : Exp(), value(literalValue(str)) {}
 
-    NumB::NumB(const char *str) : Exp(), value(std::stoi(str)) {}
+    NumB::NumB(const char *str) : Exp(), value(literalValue(str)) {}
 
     String::String(const char *str) : Exp(), value(str) {
         // Remove the quotes
@@ -35,13 +35,16 @@ namespace ast {
         STRING
     };
 
+    // Line the scanner running on this thread has reached, maintained by flex
+    extern thread_local int parsing_line;
+
     /* Base class for all AST nodes */
     class Node {
     public:
         // Line number in the source code
         int line;
 
-        // Use this constructor only while parsing in bison or flex
+        // Use this constructor only while parsing in bison or flex (reads parsing_line)
         Node();
 
         // Accept method for visitor pattern
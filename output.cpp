@@ -1,5 +1,6 @@
 #include "output.hpp"
 #include <iostream>
+#include <sstream>
 
 namespace output {
     /* Helper functions */
@@ -23,82 +24,101 @@ namespace output {
 
     /* Error handling functions */
 
+    CompileError::CompileError(const std::string &message) : std::runtime_error(message) {}
+
     void errorLex(int lineno) {
-        std::cout << "line " << lineno << ": lexical error\n";
-        exit(0);
+        std::ostringstream message;
+        message << "line " << lineno << ": lexical error\n";
+        throw CompileError(message.str());
     }
 
     void errorSyn(int lineno) {
-        std::cout << "line " << lineno << ": syntax error\n";
-        exit(0);
+        std::ostringstream message;
+        message << "line " << lineno << ": syntax error\n";
+        throw CompileError(message.str());
     }
 
     void errorUndef(int lineno, const std::string &id) {
-        std::cout << "line " << lineno << ":" << " variable " << id << " is not defined" << std::endl;
-        exit(0);
+        std::ostringstream message;
+        message << "line " << lineno << ":" << " variable " << id << " is not defined" << std::endl;
+        throw CompileError(message.str());
     }
 
     void errorDefAsFunc(int lineno, const std::string &id) {
-        std::cout << "line " << lineno << ":" << " symbol " << id << " is a function" << std::endl;
-        exit(0);
+        std::ostringstream message;
+        message << "line " << lineno << ":" << " symbol " << id << " is a function" << std::endl;
+        throw CompileError(message.str());
     }
 
     void errorDefAsVar(int lineno, const std::string &id) {
-        std::cout << "line " << lineno << ":" << " symbol " << id << " is a variable" << std::endl;
-        exit(0);
+        std::ostringstream message;
+        message << "line " << lineno << ":" << " symbol " << id << " is a variable" << std::endl;
+        throw CompileError(message.str());
     }
 
     void errorDef(int lineno, const std::string &id) {
-        std::cout << "line " << lineno << ":" << " symbol " << id << " is already defined" << std::endl;
-        exit(0);
+        std::ostringstream message;
+        message << "line " << lineno << ":" << " symbol " << id << " is already defined" << std::endl;
+        throw CompileError(message.str());
     }
 
     void errorUndefFunc(int lineno, const std::string &id) {
-        std::cout << "line " << lineno << ":" << " function " << id << " is not defined" << std::endl;
-        exit(0);
+        std::ostringstream message;
+        message << "line " << lineno << ":" << " function " << id << " is not defined" << std::endl;
+        throw CompileError(message.str());
     }
 
     void errorMismatch(int lineno) {
-        std::cout << "line " << lineno << ":" << " type mismatch" << std::endl;
-        exit(0);
+        std::ostringstream message;
+        message << "line " << lineno << ":" << " type mismatch" << std::endl;
+        throw CompileError(message.str());
     }
 
     void errorPrototypeMismatch(int lineno, const std::string &id, std::vector<std::string> &paramTypes) {
-        std::cout << "line " << lineno << ": prototype mismatch, function " << id << " expects parameters (";
+        std::ostringstream message;
+        message << "line " << lineno << ": prototype mismatch, function " << id << " expects parameters (";
 
         for (int i = 0; i < paramTypes.size(); ++i) {
-            std::cout << paramTypes[i];
+            message << paramTypes[i];
             if (i != paramTypes.size() - 1)
-                std::cout << ",";
+                message << ",";
         }
 
-        std::cout << ")" << std::endl;
-        exit(0);
+        message << ")" << std::endl;
+        throw CompileError(message.str());
     }
 
     void errorUnexpectedBreak(int lineno) {
-        std::cout << "line " << lineno << ":" << " unexpected break statement" << std::endl;
-        exit(0);
+        std::ostringstream message;
+        message << "line " << lineno << ":" << " unexpected break statement" << std::endl;
+        throw CompileError(message.str());
     }
 
     void errorUnexpectedContinue(int lineno) {
-        std::cout << "line " << lineno << ":" << " unexpected continue statement" << std::endl;
-        exit(0);
+        std::ostringstream message;
+        message << "line " << lineno << ":" << " unexpected continue statement" << std::endl;
+        throw CompileError(message.str());
     }
 
     void errorMainMissing() {
-        std::cout << "Program has no 'void main()' function" << std::endl;
-        exit(0);
+        std::ostringstream message;
+        message << "Program has no 'void main()' function" << std::endl;
+        throw CompileError(message.str());
     }
 
     void errorByteTooLarge(int lineno, const int value) {
-        std::cout << "line " << lineno << ": byte value " << value << " out of range" << std::endl;
-        exit(0);
+        std::ostringstream message;
+        message << "line " << lineno << ": byte value " << value << " out of range" << std::endl;
+        throw CompileError(message.str());
+    }
+
+    CompileError internalError(const std::exception &error) {
+        return CompileError(std::string("internal error: ") + error.what() + "\n");
     }
 
     /* CodeBuffer class */
 
-    CodeBuffer::CodeBuffer() : labelCount(0), varCount(0), stringCount(0) {}
+    CodeBuffer::CodeBuffer() : labelCount(0), varCount(0) {}
 
     std::string CodeBuffer::freshLabel() {
         return "%label_" + std::to_string(labelCount++);
@@ -108,16 +128,30 @@ namespace output {
         return "%t" + std::to_string(varCount++);
     }
 
-    std::string CodeBuffer::emitString(const std::string &str) {
-        std::string var = "@.str" + std::to_string(stringCount++);
-        globalsBuffer << var << " = constant [" << str.length() + 1 << " x i8] c\"" << str << "\\00\"";
-        return var;
-    }
-
     void CodeBuffer::emit(const std::string &str) {
         buffer << str << std::endl;
     }
 
+    void CodeBuffer::emitBuffer(const CodeBuffer &other) {
+        buffer << other.buffer.str();
+    }
+
+    std::string CodeBuffer::str() const {
+        return buffer.str();
+    }
+
+    size_t CodeBuffer::size() const {
+        return buffer.str().size();
+    }
+
+    void CodeBuffer::insert(size_t position, const std::string &code) {
+        std::string text = buffer.str();
+        text.insert(position, code);
+        buffer.str(text);
+        // str() puts the write position back at the start
+        buffer.seekp(0, std::ios_base::end);
+    }
+
     void CodeBuffer::emitLabel(const std::string &label) {
         buffer << label.substr(1) << ":" << std::endl;
     }
@@ -128,7 +162,7 @@ namespace output {
     }
 
     std::ostream &operator<<(std::ostream &os, const CodeBuffer &buffer) {
-        os << buffer.globalsBuffer.str() << std::endl << buffer.buffer.str();
+        os << buffer.buffer.str();
         return os;
     }
 }
@@ -4,6 +4,7 @@
 #include <vector>
 #include <string>
 #include <sstream>
+#include <stdexcept>
 #include "visitor.hpp"
 #include "nodes.hpp"
 
@@ -11,33 +12,45 @@ namespace output {
 
     std::string toString(ast::BuiltInType type);
 
-    /* Error handling functions */
-    
-    void errorLex(int lineno);
+    /* Error handling functions
+     * Each function raises a CompileError holding the diagnostic exactly as it
+     * should be printed; the compiler stops at the first error.
+     */
+
+    class CompileError : public std::runtime_error {
+    public:
+        explicit CompileError(const std::string &message);
+    };
+
+    [[noreturn]] void errorLex(int lineno);
+
+    [[noreturn]] void errorSyn(int lineno);
 
-    void errorSyn(int lineno);
+    [[noreturn]] void errorUndef(int lineno, const std::string &id);
 
-    void errorUndef(int lineno, const std::string &id);
+    [[noreturn]] void errorDefAsFunc(int lineno, const std::string &id);
 
-    void errorDefAsFunc(int lineno, const std::string &id);
+    [[noreturn]] void errorUndefFunc(int lineno, const std::string &id);
 
-    void errorUndefFunc(int lineno, const std::string &id);
+    [[noreturn]] void errorDefAsVar(int lineno, const std::string &id);
 
-    void errorDefAsVar(int lineno, const std::string &id);
+    [[noreturn]] void errorDef(int lineno, const std::string &id);
 
-    void errorDef(int lineno, const std::string &id);
+    [[noreturn]] void errorPrototypeMismatch(int lineno, const std::string &id, std::vector<std::string> &paramTypes);
 
-    void errorPrototypeMismatch(int lineno, const std::string &id, std::vector<std::string> &paramTypes);
+    [[noreturn]] void errorMismatch(int lineno);
 
-    void errorMismatch(int lineno);
+    [[noreturn]] void errorUnexpectedBreak(int lineno);
 
-    void errorUnexpectedBreak(int lineno);
+    [[noreturn]] void errorUnexpectedContinue(int lineno);
 
-    void errorUnexpectedContinue(int lineno);
+    [[noreturn]] void errorMainMissing();
 
-    void errorMainMissing();
+    [[noreturn]] void errorByteTooLarge(int lineno, int value);
 
-    void errorByteTooLarge(int lineno, int value);
+    // Any other exception as a diagnostic, so that it ends one compilation
+    // instead of the process (a thread pool task must not throw)
+    CompileError internalError(const std::exception &error);
 
     /* CodeBuffer class
      * This class is used to store the generated code.
@@ -45,11 +58,9 @@ namespace output {
      */
     class CodeBuffer {
     private:
-        std::stringstream globalsBuffer;
         std::stringstream buffer;
         int labelCount;
         int varCount;
-        int stringCount;
 
         friend std::ostream &operator<<(std::ostream &os, const CodeBuffer &buffer);
 
@@ -71,16 +82,21 @@ namespace output {
         // Emits a label into the buffer
         void emitLabel(const std::string &label);
 
-        // Emits a constant string into the globals section of the code.
-        // Returns the name of the constant. For the string of the length n (not including null character), the type is [n+1 x i8]
-        // Usage examples:
-        //      std::string str = emitString("Hello, World!");
-        //      buffer << "call i32 (i8*, ...) @printf(i8* getelementptr inbounds ([14 x i8], [14 x i8]* " << str << ", i32 0, i32 0))" << std::endl;
-        std::string emitString(const std::string &str);
-
         // Emits a string into the buffer
         void emit(const std::string &str);
 
+        // Appends the code of another buffer (e.g. one filled by another thread)
+        void emitBuffer(const CodeBuffer &other);
+
+        // Returns the code emitted so far
+        std::string str() const;
+
+        // Length of the code emitted so far, a place insert() may add code at later
+        size_t size() const;
+
+        // Inserts code at a place size() returned earlier
+        void insert(size_t position, const std::string &code);
+
         // Template overload for general types
         template<typename T>
         CodeBuffer &operator<<(const T &value) {
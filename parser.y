@@ -1,20 +1,34 @@
+%code requires {
+#include "nodes.hpp"
+
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void* yyscan_t;
+#endif
+}
+
 %{
 
 #include "nodes.hpp"
 #include "output.hpp"
 
-// bison declarations
-extern int yylineno;
-extern int yylex();
+using namespace std;
 
-void yyerror(const char*);
+%}
 
-// root of the AST, set by the parser and used by other parts of the compiler
-std::shared_ptr<ast::Node> program;
+%code {
+// bison declarations
+int yylex(YYSTYPE *yylval_param, yyscan_t scanner);
+int yyget_lineno(yyscan_t scanner);
 
-using namespace std;
+void yyerror(yyscan_t scanner, std::shared_ptr<ast::Node> &program, const char*);
+}
 
-%}
+// The parser keeps no global state: the scanner instance and the root of the
+// AST are passed in by the caller, so several parsers can run at once
+%define api.pure full
+%lex-param {yyscan_t scanner}
+%parse-param {yyscan_t scanner} {std::shared_ptr<ast::Node> &program}
 
 %token INT BYTE BOOL VOID
 %token TRUE FALSE
@@ -134,7 +148,6 @@ Exp: LPAREN Exp RPAREN          { $$ = $2; }
 
 %%
 
-void yyerror(const char * message){
-	output::errorSyn(yylineno);
-	exit(0);
+void yyerror(yyscan_t scanner, std::shared_ptr<ast::Node> &program, const char * message){
+	output::errorSyn(yyget_lineno(scanner));
 }
\ No newline at end of file
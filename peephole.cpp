@@ -0,0 +1,225 @@
+#include "peephole.hpp"
+#include "statistics.hpp"
+#include "ir_text.hpp"
+#include <unordered_map>
+#include <vector>
+
+using namespace ir;
+
+std::string optimizePeephole(const std::string &function, Statistics *statistics) {
+    std::vector<std::string> lines = splitLines(function);
+    unsigned long zero_adds = 0, constant_casts = 0, pairs = 0, forwarded = 0, dead = 0, joined = 0;
+    unsigned long dead_slots = 0, threaded = 0, unused_values = 0;
+
+    // Forward over the instructions, rewriting each with what is known so far
+    Substitution substitution;
+    // zext result -> the i1 it extends
+    std::unordered_map<std::string, std::string> extended;
+    // slot -> value last stored to it in the current block
+    std::unordered_map<std::string, std::string> stored;
+    std::vector<std::string> kept;
+    for (const auto &original : lines) {
+        std::string line = substitution.apply(original);
+        if (isLabel(line)) stored.clear();
+
+        std::string name = definedName(line);
+        std::string rest = name.empty() ? "" : line.substr(name.size() + 3);
+        if (startsWith(rest, "add i32 0, ") || startsWith(rest, "add i1 0, ")) {
+            substitution.add(name, rest.substr(rest.find(", ") + 2));
+            ++zero_adds;
+            continue;
+        }
+        if (startsWith(rest, "zext i1 ") && endsWith(rest, " to i32")) {
+            std::string operand = rest.substr(8, rest.size() - 8 - 7);
+            if (operand == "0" || operand == "1") {
+                substitution.add(name, operand);
+                ++constant_casts;
+                continue;
+            }
+            extended[name] = operand;
+        } else if (startsWith(rest, "trunc i32 ") && endsWith(rest, " to i1")) {
+            std::string operand = rest.substr(10, rest.size() - 10 - 6);
+            if (isConstant(operand)) {
+                substitution.add(name, (std::stol(operand) & 1) ? "1" : "0");
+                ++constant_casts;
+                continue;
+            }
+            auto source = extended.find(operand);
+            if (source != extended.end()) {
+                substitution.add(name, source->second);
+                ++pairs;
+                continue;
+            }
+        } else if (startsWith(rest, "load ")) {
+            auto value = stored.find(rest.substr(rest.rfind("* ") + 2));
+            if (value != stored.end()) {
+                substitution.add(name, value->second);
+                ++forwarded;
+                continue;
+            }
+        } else if (startsWith(line, "store ")) {
+            // store <type> <value>, <type>* <slot>
+            size_t value = line.find(' ', 6) + 1;
+            size_t comma = line.find(", ", value);
+            stored[line.substr(line.rfind("* ") + 2)] = line.substr(value, comma - value);
+        }
+        kept.push_back(line);
+    }
+    // Uses above their definition in the text
+    for (auto &line : kept) {
+        line = substitution.apply(line);
+    }
+
+    // Slots that are only stored to: the stores have no effect
+    std::unordered_map<std::string, int> slot_uses, slot_stores;
+    for (const auto &line : kept) {
+        std::string name = definedName(line);
+        if (!name.empty() && startsWith(line.substr(name.size() + 3), "alloca ")) slot_uses[name] = 0;
+        if (startsWith(line, "store ")) ++slot_stores[line.substr(line.rfind("* ") + 2)];
+    }
+    for (const auto &line : kept) {
+        forEachName(line, [&](size_t begin, size_t end) {
+            auto slot = slot_uses.find(line.substr(begin, end - begin));
+            if (slot != slot_uses.end()) ++slot->second;
+        });
+    }
+    auto unused = [&](const std::string &slot) {
+        auto uses = slot_uses.find(slot);
+        return uses != slot_uses.end() && uses->second == slot_stores[slot] + 1;
+    };
+    std::vector<std::string> stored_to;
+    for (const auto &line : kept) {
+        std::string name = definedName(line);
+        if (!name.empty() && unused(name)) {
+            ++dead_slots;
+            continue;
+        }
+        if (startsWith(line, "store ") && unused(line.substr(line.rfind("* ") + 2))) continue;
+        stored_to.push_back(line);
+    }
+    kept.swap(stored_to);
+
+    // A branch to a block that only branches on goes to its target directly.
+    // Phis name the blocks they are entered from, so they rule this out.
+    if (function.find(" = phi ") == std::string::npos) {
+        std::unordered_map<std::string, std::string> forward;
+        for (size_t i = 0; i + 1 < kept.size(); ++i) {
+            if (isLabel(kept[i]) && startsWith(kept[i + 1], "br label %")) {
+                forward[kept[i].substr(0, kept[i].size() - 1)] = kept[i + 1].substr(10);
+            }
+        }
+        auto destination = [&forward](std::string label) {
+            // Bounded, a loop of empty blocks has no end
+            for (size_t steps = 0; steps < forward.size(); ++steps) {
+                auto next = forward.find(label);
+                if (next == forward.end()) break;
+                label = next->second;
+            }
+            return label;
+        };
+        for (auto &line : kept) {
+            if (!startsWith(line, "br ")) continue;
+            std::string rewritten;
+            size_t copied = 0;
+            for (size_t at = line.find("label %"); at != std::string::npos; at = line.find("label %", at + 7)) {
+                size_t end = at + 7;
+                while (end < line.size() && isNameChar(line[end])) ++end;
+                rewritten.append(line, copied, at + 7 - copied);
+                rewritten += destination(line.substr(at + 7, end - at - 7));
+                copied = end;
+            }
+            rewritten.append(line, copied, std::string::npos);
+            if (rewritten != line) ++threaded;
+            // br i1 <condition>, label %X, label %X goes to X either way
+            size_t first = rewritten.find(", label %");
+            size_t second = first == std::string::npos ? first : rewritten.find(", label %", first + 2);
+            if (second != std::string::npos &&
+                rewritten.compare(first + 2, second - first - 2, rewritten, second + 2, std::string::npos) == 0) {
+                rewritten = "br " + rewritten.substr(second + 2);
+            }
+            line = rewritten;
+        }
+    }
+
+    // Instructions after a terminator, up to a label some branch refers to,
+    // never run; removing them may leave more labels without references
+    for (bool changed = true; changed;) {
+        changed = false;
+        std::unordered_map<std::string, int> references = labelReferences(kept);
+        std::vector<std::string> live;
+        bool reachable = true;
+        for (const auto &line : kept) {
+            if (startsWith(line, "define ") || line == "}") {
+                reachable = true;
+            } else if (isLabel(line)) {
+                if (!reachable && references[line.substr(0, line.size() - 1)] == 0) {
+                    changed = true;
+                    continue;
+                }
+                reachable = true;
+            } else if (!reachable) {
+                ++dead;
+                changed = true;
+                continue;
+            } else if (isTerminator(line)) {
+                reachable = false;
+            }
+            live.push_back(line);
+        }
+        kept.swap(live);
+    }
+
+    // A block entered only from the block right above it continues that block
+    std::unordered_map<std::string, int> references = labelReferences(kept);
+    std::vector<std::string> joined_lines;
+    for (size_t i = 0; i < kept.size(); ++i) {
+        if (startsWith(kept[i], "br label %") && i + 1 < kept.size() && isLabel(kept[i + 1])) {
+            std::string target = kept[i + 1].substr(0, kept[i + 1].size() - 1);
+            if (kept[i] == "br label %" + target && references[target] == 1) {
+                ++joined;
+                ++i;
+                continue;
+            }
+        }
+        joined_lines.push_back(kept[i]);
+    }
+    kept.swap(joined_lines);
+
+    // Results nothing uses, of instructions that do nothing else; removing
+    // one may leave its operands unused
+    std::vector<std::string> used = kept;
+    for (bool changed = true; changed;) {
+        changed = false;
+        std::unordered_map<std::string, int> uses;
+        for (const auto &line : used) {
+            std::string name = definedName(line);
+            forEachName(line, [&](size_t begin, size_t end) {
+                if (begin != 0 || name.empty()) ++uses[line.substr(begin, end - begin)];
+            });
+        }
+        std::vector<std::string> live;
+        for (const auto &line : used) {
+            std::string name = definedName(line);
+            if (!name.empty() && uses[name] == 0 && !isCall(line.substr(name.size() + 3))) {
+                ++unused_values;
+                changed = true;
+                continue;
+            }
+            live.push_back(line);
+        }
+        used.swap(live);
+    }
+
+    if (statistics) {
+        statistics->add("peephole add of zero", zero_adds);
+        statistics->add("peephole constant casts", constant_casts);
+        statistics->add("peephole zext/trunc pairs", pairs);
+        statistics->add("peephole forwarded loads", forwarded);
+        statistics->add("peephole dead slots", dead_slots);
+        statistics->add("peephole dead instructions", dead);
+        statistics->add("peephole threaded branches", threaded);
+        statistics->add("peephole joined blocks", joined);
+        statistics->add("peephole unused values", unused_values);
+    }
+    return joinLines(used);
+}
@@ -0,0 +1,23 @@
+#ifndef PEEPHOLE_HPP
+#define PEEPHOLE_HPP
+
+#include <string>
+
+class Statistics;
+
+/* Peephole optimizer for the IR text of one function (see ir_text.hpp). It
+   walks the instructions in order and rewrites the waste the generator
+   leaves behind, each rule with a counter of its own in statistics:
+   - constants materialized by "add i32 0, N" are used directly
+   - casts between i1 and i32 of constants are constants
+   - a trunc back to i1 of a zext from i1 is the original value
+   - a load from a slot stored to earlier in the block is the stored value
+   - slots that are never loaded are removed with their stores
+   - a branch to a block that only branches on goes straight to its target
+   - instructions after a terminator and blocks no branch reaches are removed
+   - "br label %X" right before the only reference to X joins the blocks
+   - instructions other than calls whose result nothing uses are removed
+   A replaced value is substituted wherever it is used. */
+std::string optimizePeephole(const std::string &function, Statistics *statistics);
+
+#endif // PEEPHOLE_HPP
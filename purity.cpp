@@ -0,0 +1,97 @@
+#include "purity.hpp"
+#include "ast_walker.hpp"
+#include <vector>
+
+namespace {
+    // What a body does by itself, and the functions it calls
+    class EffectCollector : public AstWalker {
+    public:
+        Effects effects;
+        std::vector<std::string> callees;
+
+        using AstWalker::visit;
+        void visit(ast::Call &node) override {
+            const std::string &name = node.func_id->value;
+            if (name == "print" || name == "printi") {
+                effects.prints = true;
+            } else {
+                callees.push_back(name);
+            }
+            AstWalker::visit(node);
+        }
+        void visit(ast::BinOp &node) override {
+            if (node.op == ast::DIV && !nonzero(*node.right)) effects.traps = true;
+            AstWalker::visit(node);
+        }
+
+    private:
+        static bool nonzero(ast::Exp &divisor) {
+            if (auto num = dynamic_cast<ast::Num*>(&divisor)) return num->value != 0;
+            if (auto num = dynamic_cast<ast::NumB*>(&divisor)) return num->value != 0;
+            return false;
+        }
+    };
+
+    void include(Effects &into, const Effects &from, bool &changed) {
+        if ((from.prints && !into.prints) || (from.traps && !into.traps) || (from.writes && !into.writes)) {
+            into.prints |= from.prints;
+            into.traps |= from.traps;
+            into.writes |= from.writes;
+            changed = true;
+        }
+    }
+}
+
+Purity analyzePurity(ast::Funcs &program, bool memoize) {
+    Purity purity;
+    std::unordered_map<std::string, std::vector<std::string>> calls;
+    for (const auto &func : program.funcs) {
+        EffectCollector collector;
+        func->body->accept(collector);
+        purity.effects[func->id->value] = collector.effects;
+        calls[func->id->value] = collector.callees;
+    }
+
+    Effects anything;
+    anything.prints = anything.traps = anything.writes = true;
+    auto propagate = [&] {
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (const auto &func : program.funcs) {
+                Effects &effects = purity.effects[func->id->value];
+                for (const auto &callee : calls[func->id->value]) {
+                    auto found = purity.effects.find(callee);
+                    include(effects, found == purity.effects.end() ? anything : found->second, changed);
+                }
+            }
+        }
+    };
+    propagate();
+    if (!memoize) return purity;
+
+    for (const auto &func : program.funcs) {
+        const std::string &name = func->id->value;
+        size_t parameters = func->formals ? func->formals->formals.size() : 0;
+        if (purity.effects[name].prints || func->return_type->type == ast::BuiltInType::VOID ||
+            parameters == 0 || parameters > Purity::max_memoized_parameters || name == "main") {
+            continue;
+        }
+        // Recursive: some chain of calls leads back to it
+        std::unordered_set<std::string> reached;
+        std::vector<std::string> pending = calls[name];
+        while (!pending.empty() && !reached.count(name)) {
+            std::string callee = pending.back();
+            pending.pop_back();
+            if (!calls.count(callee) || !reached.insert(callee).second) continue;
+            pending.insert(pending.end(), calls[callee].begin(), calls[callee].end());
+        }
+        if (reached.count(name)) purity.memoized.insert(name);
+    }
+
+    // Filling a cache writes memory, which its callers do as well
+    for (const auto &name : purity.memoized) {
+        purity.effects[name].writes = true;
+    }
+    propagate();
+    return purity;
+}
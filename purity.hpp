@@ -0,0 +1,41 @@
+#ifndef PURITY_HPP
+#define PURITY_HPP
+
+#include "nodes.hpp"
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+/* Interprocedural purity analysis. A function has the effects of its own
+   body and of every function it calls, found by following the call graph
+   until nothing changes, so cycles of calls are covered. Calls to
+   functions outside the program (imported from other modules) may do
+   anything. */
+
+struct Effects {
+    // Calls print or printi
+    bool prints = false;
+    // Divides by a value not known to be nonzero, which may end the program
+    bool traps = false;
+    // Writes memory of its own: the cache of a memoized function
+    bool writes = false;
+
+    // Neither reads nor writes memory the caller can see, so it is readnone
+    bool pure() const { return !prints && !traps && !writes; }
+};
+
+struct Purity {
+    std::unordered_map<std::string, Effects> effects;
+    // Functions whose results are cached by their arguments (--memoize):
+    // recursive ones that do not print, return a value and take between one
+    // and max_memoized_parameters parameters. Trapping does not matter, the
+    // program ends before anything is cached.
+    std::unordered_set<std::string> memoized;
+
+    static constexpr size_t max_memoized_parameters = 3;
+};
+
+Purity analyzePurity(ast::Funcs &program, bool memoize);
+
+#endif // PURITY_HPP
@@ -0,0 +1,77 @@
+#include "reachability.hpp"
+#include "ast_walker.hpp"
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+    // Names of the functions a subtree calls
+    class CallCollector : public AstWalker {
+    public:
+        std::vector<std::string> callees;
+
+        using AstWalker::visit;
+        void visit(ast::Call &node) override {
+            callees.push_back(node.func_id->value);
+            AstWalker::visit(node);
+        }
+    };
+
+    class LibraryCollector : public AstWalker {
+    public:
+        LibraryUse use;
+
+        using AstWalker::visit;
+        void visit(ast::Call &node) override {
+            if (node.func_id->value == "print") use.print = true;
+            if (node.func_id->value == "printi") use.printi = true;
+            AstWalker::visit(node);
+        }
+        void visit(ast::BinOp &node) override {
+            if (node.op == ast::DIV) use.division = true;
+            AstWalker::visit(node);
+        }
+    };
+}
+
+LibraryUse LibraryUse::all() {
+    LibraryUse use;
+    use.print = use.printi = use.division = true;
+    return use;
+}
+
+size_t removeUnreachable(ast::Funcs &program) {
+    std::unordered_map<std::string, ast::FuncDecl*> functions;
+    for (const auto &func : program.funcs) {
+        functions[func->id->value] = func.get();
+    }
+    if (!functions.count("main")) return 0;
+
+    std::unordered_set<std::string> reached = {"main"};
+    std::vector<ast::FuncDecl*> pending = {functions["main"]};
+    while (!pending.empty()) {
+        ast::FuncDecl *func = pending.back();
+        pending.pop_back();
+        CallCollector collector;
+        func->accept(collector);
+        for (const auto &callee : collector.callees) {
+            auto found = functions.find(callee);
+            if (found != functions.end() && reached.insert(callee).second) pending.push_back(found->second);
+        }
+    }
+
+    size_t before = program.funcs.size();
+    std::vector<std::shared_ptr<ast::FuncDecl>> kept;
+    for (const auto &func : program.funcs) {
+        if (reached.count(func->id->value)) kept.push_back(func);
+    }
+    program.funcs.swap(kept);
+    return before - program.funcs.size();
+}
+
+LibraryUse libraryUse(ast::Funcs &program) {
+    LibraryCollector collector;
+    program.accept(collector);
+    return collector.use;
+}
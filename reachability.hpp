@@ -0,0 +1,32 @@
+#ifndef REACHABILITY_HPP
+#define REACHABILITY_HPP
+
+#include "nodes.hpp"
+
+/* Whole-program reachability.
+   The call graph is followed from main; functions it never reaches are
+   removed from the program before code generation, and the library is
+   reduced to the functions the remaining code calls. Only for whole
+   programs: every function of a module may be called by another one. */
+
+// The parts of the library a program needs
+struct LibraryUse {
+    bool print = false;
+    bool printi = false;
+    // Any division, which checks its divisor
+    bool division = false;
+
+    bool any() const { return print || printi || division; }
+
+    // Everything, for code whose callers are not known
+    static LibraryUse all();
+};
+
+// Removes the functions main does not reach, keeping the order of the
+// others. Returns how many were removed; none when there is no main.
+size_t removeUnreachable(ast::Funcs &program);
+
+// What the functions of the program call from the library
+LibraryUse libraryUse(ast::Funcs &program);
+
+#endif // REACHABILITY_HPP
@@ -14,11 +14,19 @@ EXEC_NAME="./hw5"
 TEST_DIRS=("./segel_tests/" "./tdd_tests/")
 OUTPUT_DIR="./tests_results/"
 
-# Check for verbose flag
+# Check for verbose flag, and for the optional passes over the same tests:
+# --interpret runs them on the bytecode interpreter, --asm builds them with
+# the x86-64 backend and runs the executables
 VERBOSE=0
-if [[ "$1" == "-v" ]]; then
-    VERBOSE=1
-fi
+INTERPRET=0
+ASM=0
+for arg in "$@"; do
+    case "$arg" in
+        -v) VERBOSE=1 ;;
+        --interpret) INTERPRET=1 ;;
+        --asm) ASM=1 ;;
+    esac
+done
 
 # ================= Compile The code =================
 echo -e "${BLUE}============== Compiling the code! ==============${NC}"
@@ -37,6 +45,50 @@ mkdir -p ${OUTPUT_DIR}
 passed_tests=0
 total_tests=0
 
+# Counts a test that passed when the actual file matches the expected one
+check_result() {
+    local test_name="$1" expected="$2" actual="$3"
+    total_tests=$((total_tests + 1))
+    if diff -q "$expected" "$actual" > /dev/null 2>&1; then
+        echo -e "${GREEN}Test ${test_name} passed!${NC}"
+        passed_tests=$((passed_tests + 1))
+    else
+        echo -e "${RED}Failed test: ${test_name}!${NC}"
+        if [ $VERBOSE -eq 1 ]; then
+            echo "Diff:"
+            diff -u "$expected" "$actual"
+            echo "------------------------------------------------"
+        fi
+    fi
+}
+
+# Counts a test that passed when the command succeeds
+check_true() {
+    local test_name="$1"
+    shift
+    total_tests=$((total_tests + 1))
+    if "$@"; then
+        echo -e "${GREEN}Test ${test_name} passed!${NC}"
+        passed_tests=$((passed_tests + 1))
+    else
+        echo -e "${RED}Failed test: ${test_name}!${NC}"
+    fi
+}
+
+# Compiles edit $2 of tdd_tests/edits with the extra flags in $3, compares
+# the compiler's output with that of a compile without cache or state, and
+# what lli prints with the expected output
+check_edit() {
+    local test_name="$1" edit="$2" flags="$3"
+    local base="${OUTPUT_DIR}${test_name}"
+    $EXEC_NAME $flags < "./tdd_tests/edits/${edit}.in" > "${base}.ll" 2> /dev/null
+    $EXEC_NAME $(echo "$flags" | sed -E 's/--(cache|incremental) [^ ]+//') \
+        < "./tdd_tests/edits/${edit}.in" > "${base}.fresh.ll" 2> /dev/null
+    check_result "${test_name} (same code)" "${base}.fresh.ll" "${base}.ll"
+    lli "${base}.ll" > "${base}.res" 2> /dev/null
+    check_result "${test_name} (output)" "./tdd_tests/edits/${edit}.out" "${base}.res"
+}
+
 for TESTS_DIR in "${TEST_DIRS[@]}"; do
     if [ ! -d "$TESTS_DIR" ]; then
         echo -e "${YELLOW}Directory $TESTS_DIR does not exist. Skipping.${NC}"
@@ -45,6 +97,11 @@ for TESTS_DIR in "${TEST_DIRS[@]}"; do
 
     echo -e "${BLUE}============== Running Tests from ${TESTS_DIR} ==============${NC}"
 
+    # --- STEP 1: Generate LLVM IR ---
+    # Compile the whole directory in one process. Every test gets its .ll file
+    # in the output directory (IR or the compiler's error message).
+    $EXEC_NAME --batch "$TESTS_DIR" --out-dir "$OUTPUT_DIR" > /dev/null
+
     # Loop over all .in files in the tests directory
     for test_file in ${TESTS_DIR}*.in; do
         # Check if files exist to avoid error if directory is empty
@@ -61,10 +118,6 @@ for TESTS_DIR in "${TEST_DIRS[@]}"; do
         llvm_output="${OUTPUT_DIR}${test_name}.ll"  # Intermediate LLVM file
         actual_output="${OUTPUT_DIR}${test_name}.res" # Final result after lli
 
-        # --- STEP 1: Generate LLVM IR ---
-        # Run your compiler. Output goes to .ll file. Stderr is redirected to stdout.
-        $EXEC_NAME < "$test_file" > "$llvm_output" 2>&1
-
         # --- STEP 2: Run LLI ---
         # Try to run lli on the generated file.
         # We suppress lli's stderr to keep the console clean (in case of syntax errors in the .ll file)
@@ -89,6 +142,109 @@ for TESTS_DIR in "${TEST_DIRS[@]}"; do
     done
 done
 
+# ================= Other backends =================
+# The interpreter and the asm backend lower the AST on their own and must
+# print what lli printed. A test that does not compile must give the
+# diagnostic the LLVM compile gave.
+for backend in interpret asm; do
+    [ "$backend" == "interpret" ] && [ $INTERPRET -eq 0 ] && continue
+    [ "$backend" == "asm" ] && [ $ASM -eq 0 ] && continue
+    echo -e "${BLUE}============== Running Tests on the ${backend} backend ==============${NC}"
+    for TESTS_DIR in "${TEST_DIRS[@]}"; do
+        for test_file in ${TESTS_DIR}*.in; do
+            [ -e "$test_file" ] || continue
+            filename=$(basename -- "$test_file")
+            test_name="${filename%.*}"
+            expected_output="${TESTS_DIR}${test_name}.out"
+            grep -Eq "^line [0-9]+:" "${OUTPUT_DIR}${test_name}.ll" && expected_output="${OUTPUT_DIR}${test_name}.ll"
+            actual_output="${OUTPUT_DIR}${test_name}.${backend}.res"
+            if [ "$backend" == "interpret" ]; then
+                $EXEC_NAME --interpret < "$test_file" > "$actual_output" 2> /dev/null
+            else
+                executable="${OUTPUT_DIR}${test_name}.exe"
+                $EXEC_NAME --backend asm -o "$executable" < "$test_file" > "$actual_output" 2> /dev/null
+                [ -s "$actual_output" ] || "$executable" > "$actual_output" 2> /dev/null
+            fi
+            check_result "${test_name} (${backend})" "$expected_output" "$actual_output"
+        done
+    done
+done
+
+# ================= Compile cache =================
+echo -e "${BLUE}============== Running Tests of the compile cache ==============${NC}"
+# The corpus twice through one cache: the second run is served from it, and
+# both must give the files of the uncached compile above. A cache too small
+# for the corpus evicts, and still gives the same files.
+CACHE_DIR="${OUTPUT_DIR}cache/"
+cat "${OUTPUT_DIR}"*.ll > "${OUTPUT_DIR}uncached.all"
+for run in cold warm small; do
+    mkdir -p "${OUTPUT_DIR}${run}/"
+    cache_flags="--cache ${CACHE_DIR}"
+    [ "$run" == "small" ] && cache_flags="--cache ${OUTPUT_DIR}small_cache/ --cache-size 4096"
+    for TESTS_DIR in "${TEST_DIRS[@]}"; do
+        $EXEC_NAME --batch "$TESTS_DIR" --out-dir "${OUTPUT_DIR}${run}/" $cache_flags --cache-stats \
+            > /dev/null 2>> "${OUTPUT_DIR}${run}.stats"
+    done
+    cat "${OUTPUT_DIR}${run}/"*.ll > "${OUTPUT_DIR}${run}.all"
+    check_result "cache_${run}_corpus" "${OUTPUT_DIR}uncached.all" "${OUTPUT_DIR}${run}.all"
+done
+check_true "cache_warm_hits" grep -Eq "program [0-9]+ hits / 0 misses" "${OUTPUT_DIR}warm.stats"
+check_true "cache_small_evicts" grep -Eq " [1-9][0-9]* evicted" "${OUTPUT_DIR}small.stats"
+
+# Edits of one program through one cache: a callee inlined into its caller
+# changes (c2), a string literal moves those after it (c3), a signature
+# change breaks a caller (c4) and the first version comes back (c1)
+step=0
+for edit in c1 c2 c3 c4 c1; do
+    step=$((step + 1))
+    check_edit "cache_edit_${step}_${edit}" "$edit" "--cache ${OUTPUT_DIR}edit_cache/"
+done
+
+# ================= Incremental compilation =================
+echo -e "${BLUE}============== Running Tests of incremental compilation ==============${NC}"
+# The same edits with one state file, then the state of one setting reused
+# by compiles with others (-O0, --memoize) and back
+STATE="${OUTPUT_DIR}edits.state"
+step=0
+for edit in c1 c2 c3 c4 c1 c1:-O0 c1:--memoize c2; do
+    step=$((step + 1))
+    flags="${edit#*:}"
+    [ "$flags" == "$edit" ] && flags=""
+    edit="${edit%%:*}"
+    check_edit "incremental_${step}_${edit}" "$edit" "--incremental ${STATE} ${flags}"
+done
+# Nothing changed since the last compile: nothing is generated again
+$EXEC_NAME --incremental "$STATE" --cache-stats < ./tdd_tests/edits/c2.in > /dev/null 2> "${OUTPUT_DIR}incremental.stats"
+check_true "incremental_unchanged" grep -q " 0 regenerated" "${OUTPUT_DIR}incremental.stats"
+
+# ================= Separate compilation =================
+echo -e "${BLUE}============== Running Tests of separate compilation ==============${NC}"
+# Two modules with strings and a division, compiled against each other's
+# interface and linked; then a call that does not match the interface, a
+# definition that no longer matches the declaration of an importer and a
+# module linked twice
+MODULES_TESTS="./tdd_tests/modules/"
+MODULES_DIR="${OUTPUT_DIR}modules/"
+mkdir -p "$MODULES_DIR"
+$EXEC_NAME --module lib --emit-interface "${MODULES_DIR}lib.fnci" < "${MODULES_TESTS}lib.in" > "${MODULES_DIR}lib.ll"
+$EXEC_NAME --module app --import "${MODULES_DIR}lib.fnci" < "${MODULES_TESTS}app.in" > "${MODULES_DIR}app.ll"
+$EXEC_NAME --module lib < "${MODULES_TESTS}lib_changed.in" > "${MODULES_DIR}lib_changed.ll"
+$EXEC_NAME --module app --import "${MODULES_DIR}lib.fnci" < "${MODULES_TESTS}app_mismatch.in" \
+    > "${MODULES_DIR}app_mismatch.err"
+check_result "modules_mismatched_call" "${MODULES_TESTS}app_mismatch.err" "${MODULES_DIR}app_mismatch.err"
+# Linked from inside the directory, so the messages name the files only
+COMPILER="$(pwd)/${EXEC_NAME}"
+(
+    cd "$MODULES_DIR" || exit
+    "$COMPILER" --link lib.ll app.ll > program.ll
+    lli program.ll > program.res 2> /dev/null
+    "$COMPILER" --link lib_changed.ll app.ll > /dev/null 2> link_changed.err
+    "$COMPILER" --link lib.ll lib.ll app.ll > /dev/null 2> link_duplicate.err
+)
+check_result "modules_program" "${MODULES_TESTS}program.out" "${MODULES_DIR}program.res"
+check_result "modules_changed_definition" "${MODULES_TESTS}link_changed.err" "${MODULES_DIR}link_changed.err"
+check_result "modules_duplicate_definition" "${MODULES_TESTS}link_duplicate.err" "${MODULES_DIR}link_duplicate.err"
+
 # ================= Summary =================
 echo -e "\n${BLUE}============== Summary ==============${NC}"
 if [ $passed_tests -eq $total_tests ] && [ $total_tests -gt 0 ]; then
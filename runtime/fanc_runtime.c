@@ -0,0 +1,84 @@
+/* Runtime of FanC programs compiled to native executables (hw5 -o).
+   Provides what CodeGenerator::emitRuntime defines for IR that runs under
+   lli: print, printi and the division by zero error. The generated code
+   declares them when compiled with an external runtime; the asm backend
+   always calls them.
+
+   Output is collected in a buffer and written with write(2) when it fills
+   up and when the process exits, including through the exit(0) of a
+   division by zero. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define OUTPUT_CAPACITY 65536
+
+static char output[OUTPUT_CAPACITY];
+static size_t output_length;
+
+static void write_all(const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(1, data, length);
+        if (written <= 0) return;
+        data += written;
+        length -= (size_t)written;
+    }
+}
+
+static void flush(void) {
+    write_all(output, output_length);
+    output_length = 0;
+}
+
+/* The text and a newline; text longer than the buffer is written directly */
+static void line(const char *text, size_t length) {
+    if (output_length + length >= OUTPUT_CAPACITY) {
+        flush();
+        if (length >= OUTPUT_CAPACITY) {
+            write_all(text, length);
+            length = 0;
+        }
+    }
+    memcpy(output + output_length, text, length);
+    output_length += length;
+    output[output_length++] = '\n';
+}
+
+/* The length of a literal is known at compile time and passed along */
+void print(const char *text, int length) {
+    line(text, (size_t)length);
+}
+
+void printi(int value) {
+    char digits[11];
+    char *end = digits + sizeof(digits);
+    char *begin = end;
+    unsigned magnitude = value < 0 ? 0u - (unsigned)value : (unsigned)value;
+    do {
+        *--begin = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0) *--begin = '-';
+    line(begin, (size_t)(end - begin));
+}
+
+/* The generated code refers to it by its IR name */
+void fanc_division_error(void) __asm__(".division_error");
+
+void fanc_division_error(void) {
+    static const char message[] = "Error division by zero";
+    line(message, sizeof(message) - 1);
+    exit(0);
+}
+
+/* FanC's main returns void. The executable is linked with --wrap=main, so
+   the C startup code calls this function instead and the process exits
+   with status 0. */
+void __real_main(void);
+
+int __wrap_main(void) {
+    atexit(flush);
+    __real_main();
+    return 0;
+}
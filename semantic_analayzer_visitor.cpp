@@ -1,9 +1,30 @@
 #include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <unordered_set>
 #include <vector>
 #include "semantic_analayzer_visitor.hpp"
+#include "thread_pool.hpp"
 
-SemanticAnalayzerVisitor::SemanticAnalayzerVisitor() : number_of_while_inside(0) {}
+SemanticAnalayzerVisitor::SemanticAnalayzerVisitor(unsigned jobs)
+    : function_symbol_table(std::make_shared<std::vector<FunctionSymbolEntry>>()),
+      number_of_while_inside(0), jobs(jobs), is_module(false) {}
+
+SemanticAnalayzerVisitor::SemanticAnalayzerVisitor(std::shared_ptr<std::vector<FunctionSymbolEntry>> functions,
+                                                   const FunctionSymbolEntry& function)
+    : function_symbol_table(std::move(functions)), current_function(function),
+      number_of_while_inside(0), jobs(1), is_module(false) {
+    offset_stack.push(0);
+}
+
+void SemanticAnalayzerVisitor::skipBodies(std::vector<bool> skip) {
+    this->skip = std::move(skip);
+}
+
+void SemanticAnalayzerVisitor::compileModule(const std::vector<ModuleInterface>& imports) {
+    is_module = true;
+    this->imports = imports;
+}
 
 void SemanticAnalayzerVisitor::visit(ast::Funcs &node) {
     offset_stack.push(0);
@@ -11,8 +32,20 @@ void SemanticAnalayzerVisitor::visit(ast::Funcs &node) {
     // Register library functions
     FunctionSymbolEntry print_entry = {"print", 0, ast::BuiltInType::VOID, {ast::BuiltInType::STRING}};
     FunctionSymbolEntry printi_entry = {"printi", 0, ast::BuiltInType::VOID, {ast::BuiltInType::INT}};
-    function_symbol_table.push_back(print_entry);
-    function_symbol_table.push_back(printi_entry);
+    function_symbol_table->push_back(print_entry);
+    function_symbol_table->push_back(printi_entry);
+    std::unordered_set<std::string> defined_functions = {"print", "printi"};
+
+    // Imported functions come first, so a local function may not reuse their
+    // names. Two imports with one name are left to the link step.
+    for (const auto& module : imports) {
+        for (const auto& function : module.functions) {
+            if (defined_functions.insert(function.name).second) {
+                function_symbol_table->push_back({function.name, 0, function.return_type, function.arguments});
+            }
+        }
+    }
+    size_t first_function = function_symbol_table->size();
 
     bool has_valid_main = false;
 
@@ -27,26 +60,53 @@ void SemanticAnalayzerVisitor::visit(ast::Funcs &node) {
         }
         
         FunctionSymbolEntry function_entry = {function->id->value, 0, function->return_type->type, arguments};
-        for (const auto& function_symbol : function_symbol_table) {
-            if (function_entry.name == function_symbol.name) {
-                output::errorDef(function->id->line, function_entry.name);
-            }
+        // This loop runs on every (incremental) compile, so no scan of the table
+        if (!defined_functions.insert(function_entry.name).second) {
+            output::errorDef(function->id->line, function_entry.name);
         }
-        function_symbol_table.push_back(function_entry);
+        function_symbol_table->push_back(function_entry);
 
         if (function_entry.name == "main" && function_entry.return_type == ast::BuiltInType::VOID && function_entry.arguments.empty()) {
             has_valid_main = true;
         }
     }
 
-    if (!has_valid_main) {
+    if (!has_valid_main && !is_module) {
         output::errorMainMissing();
     }
 
-    for (auto it = node.funcs.begin(); it != node.funcs.end(); ++it) {
-        // Offset +2 to skip print/printi
-        current_function = function_symbol_table[std::distance(node.funcs.begin(), it) + 2];
-        (*it)->accept(*this);
+    // Bodies only read the function table, so they are checked concurrently.
+    // Every function records its own error and the first one in source order
+    // is reported, exactly as a serial walk would.
+    std::vector<std::unique_ptr<output::CompileError>> errors(node.funcs.size());
+    std::atomic<size_t> first_error(node.funcs.size());
+
+    ThreadPool pool(std::min<size_t>(ThreadPool::defaultThreads(jobs), node.funcs.size()));
+    for (size_t i = 0; i < node.funcs.size(); ++i) {
+        if (i < skip.size() && skip[i]) continue;
+        pool.submit([this, &node, &errors, &first_error, first_function, i] {
+            // Nothing after an already failed function can be reported
+            if (i > first_error.load()) return;
+            try {
+                // Skip print/printi and the imports
+                SemanticAnalayzerVisitor function_visitor(function_symbol_table, (*function_symbol_table)[first_function + i]);
+                node.funcs[i]->accept(function_visitor);
+            } catch (const output::CompileError &error) {
+                errors[i] = std::make_unique<output::CompileError>(error);
+            } catch (const std::exception &error) {
+                errors[i] = std::make_unique<output::CompileError>(output::internalError(error));
+            }
+            if (errors[i]) {
+                size_t seen = first_error.load();
+                while (i < seen && !first_error.compare_exchange_weak(seen, i)) {
+                }
+            }
+        });
+    }
+    pool.wait();
+
+    for (const auto& error : errors) {
+        if (error) throw *error;
     }
 }
 
@@ -59,7 +119,7 @@ void SemanticAnalayzerVisitor::visit(ast::FuncDecl &node) {
             for (const auto& symbol : symbols_in_scope) {
                 if (symbol.name == formal->id->value) output::errorDef(formal->line, formal->id->value);
             }
-            for (const auto& function : function_symbol_table) {
+            for (const auto& function : *function_symbol_table) {
                 if (function.name == formal->id->value) output::errorDef(formal->line, formal->id->value);
             }
             SymbolEntry entry = {formal->id->value, formal->type->type, offset_stack.top()--};
@@ -151,7 +211,7 @@ void SemanticAnalayzerVisitor::visit(ast::VarDecl &node) {
         }
     } 
     
-    for (const auto& function : function_symbol_table) {
+    for (const auto& function : *function_symbol_table) {
         if (function.name == node.id->value) {
             output::errorDef(node.line, node.id->value);
         }
@@ -160,7 +220,7 @@ void SemanticAnalayzerVisitor::visit(ast::VarDecl &node) {
     if (node.init_exp) {
         node.init_exp->accept(*this);
         if (auto id_exp = std::dynamic_pointer_cast<ast::ID>(node.init_exp)) {            
-            for (const auto& function : function_symbol_table) {
+            for (const auto& function : *function_symbol_table) {
                 if (function.name == id_exp->value) {
                     output::errorDefAsFunc(node.line, function.name);
                 }
@@ -199,7 +259,7 @@ void SemanticAnalayzerVisitor::visit(ast::Assign &node) {
     } 
 
     if (!is_variable_exists) {
-        for (const auto& function : function_symbol_table) {
+        for (const auto& function : *function_symbol_table) {
             if (node.id->value == function.name) {
                 output::errorDefAsFunc(node.line, node.id->value);
             }
@@ -222,7 +282,7 @@ void SemanticAnalayzerVisitor::visit(ast::Call &node) {
     bool is_function_exists = false;
     FunctionSymbolEntry called_function;
 
-    for (const auto& function : function_symbol_table) {
+    for (const auto& function : *function_symbol_table) {
         if (node.func_id->value == function.name) {
             is_function_exists = true;
             called_function = function;
@@ -323,7 +383,7 @@ void SemanticAnalayzerVisitor::visit(ast::ID &node) {
             }
         }
     }
-    for (const auto& func : function_symbol_table) {
+    for (const auto& func : *function_symbol_table) {
         if (func.name == node.value) {
             return;
         }
@@ -432,7 +492,7 @@ ast::BuiltInType SemanticAnalayzerVisitor::getExpressionType(std::shared_ptr<ast
     }
 
     if (auto call = std::dynamic_pointer_cast<ast::Call>(exp)) {
-        for (const auto& func : function_symbol_table) {
+        for (const auto& func : *function_symbol_table) {
             if (func.name == call->func_id->value) {
                 return func.return_type;
             }
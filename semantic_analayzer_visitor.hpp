@@ -9,6 +9,7 @@
 #include "visitor.hpp"
 #include "nodes.hpp"
 #include "output.hpp"
+#include "module_interface.hpp"
 
 struct SymbolEntry {
     std::string name;
@@ -25,7 +26,16 @@ struct FunctionSymbolEntry {
 
 class SemanticAnalayzerVisitor : public Visitor {
 public:
-    SemanticAnalayzerVisitor();
+    // jobs is the number of threads used to check function bodies (0 = one per hardware thread)
+    explicit SemanticAnalayzerVisitor(unsigned jobs = 1);
+
+    // Bodies of the functions marked here are known to be valid and are not
+    // checked again; signatures and main are always checked
+    void skipBodies(std::vector<bool> skip);
+
+    // Checks a module instead of a program: the functions of the imported
+    // modules may be called and main is not required
+    void compileModule(const std::vector<ModuleInterface>& imports);
 
     void visit(ast::Num &node) override;
     void visit(ast::NumB &node) override;
@@ -57,9 +67,18 @@ public:
 private:
     std::stack<int> offset_stack;
     std::vector<std::vector<SymbolEntry>> symbol_table;
-    std::vector<FunctionSymbolEntry> function_symbol_table;
+    // Shared read-only with the visitors checking the function bodies
+    std::shared_ptr<std::vector<FunctionSymbolEntry>> function_symbol_table;
     FunctionSymbolEntry current_function;
     int number_of_while_inside; 
+    unsigned jobs;
+    std::vector<bool> skip;
+    bool is_module;
+    std::vector<ModuleInterface> imports;
+
+    // Visitor for the body of a single function
+    SemanticAnalayzerVisitor(std::shared_ptr<std::vector<FunctionSymbolEntry>> functions,
+                             const FunctionSymbolEntry& function);
     
     ast::BuiltInType getExpressionType(std::shared_ptr<ast::Exp> exp);
 };
@@ -0,0 +1,55 @@
+#include "source_splitter.hpp"
+
+std::vector<SourceChunk> splitSource(const std::string &source, size_t max_funcs_per_chunk) {
+    std::vector<SourceChunk> chunks;
+    if (max_funcs_per_chunk == 0) max_funcs_per_chunk = 1;
+
+    size_t chunk_start = 0;
+    int chunk_line = 1;
+    int line = 1;
+    int depth = 0;
+    size_t funcs_in_chunk = 0;
+
+    size_t pos = 0;
+    while (pos < source.size()) {
+        char c = source[pos];
+
+        if (c == '\n') {
+            ++line;
+            ++pos;
+        } else if (c == '/' && pos + 1 < source.size() && source[pos + 1] == '/') {
+            // Comments run until the end of the line
+            while (pos < source.size() && source[pos] != '\n') ++pos;
+        } else if (c == '"') {
+            // String literals cannot span lines; \" does not close them
+            ++pos;
+            while (pos < source.size() && source[pos] != '"' && source[pos] != '\n') {
+                if (source[pos] == '\\' && pos + 1 < source.size() && source[pos + 1] != '\n') ++pos;
+                ++pos;
+            }
+            if (pos < source.size() && source[pos] == '"') ++pos;
+        } else if (c == '{') {
+            ++depth;
+            ++pos;
+        } else if (c == '}') {
+            ++pos;
+            if (--depth < 0) {
+                // Unbalanced source, leave the rest to the parser as one piece
+                break;
+            }
+            if (depth == 0 && ++funcs_in_chunk == max_funcs_per_chunk) {
+                chunks.push_back({source.substr(chunk_start, pos - chunk_start), chunk_line});
+                chunk_start = pos;
+                chunk_line = line;
+                funcs_in_chunk = 0;
+            }
+        } else {
+            ++pos;
+        }
+    }
+
+    if (chunk_start < source.size() || chunks.empty()) {
+        chunks.push_back({source.substr(chunk_start), chunk_line});
+    }
+    return chunks;
+}
@@ -0,0 +1,25 @@
+#ifndef SOURCE_SPLITTER_HPP
+#define SOURCE_SPLITTER_HPP
+
+#include <string>
+#include <vector>
+
+/* A piece of the source that holds whole top-level function declarations */
+struct SourceChunk {
+    std::string text;
+    // Line number of the first character of text in the original source
+    int first_line;
+};
+
+/* Splits a FanC source at top-level FuncDecl boundaries.
+   A boundary is the position right after a '}' that brings the brace depth
+   back to zero; braces inside string literals and "//" comments are ignored.
+   Consecutive functions are grouped so that no chunk holds more than
+   max_funcs_per_chunk of them. Parsing the chunks one after the other gives
+   the same functions, line numbers and first diagnostic as parsing the whole
+   source, because every chunk but the one containing an error is a complete
+   list of FuncDecls. If the braces do not balance, the rest of the source
+   from the last good boundary is returned as a single chunk. */
+std::vector<SourceChunk> splitSource(const std::string &source, size_t max_funcs_per_chunk);
+
+#endif // SOURCE_SPLITTER_HPP
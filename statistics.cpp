@@ -0,0 +1,27 @@
+#include "statistics.hpp"
+
+void Statistics::add(const std::string &name, unsigned long count) {
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto &counter : counters) {
+        if (counter.first == name) {
+            counter.second += count;
+            return;
+        }
+    }
+    counters.push_back({name, count});
+}
+
+unsigned long Statistics::get(const std::string &name) const {
+    std::lock_guard<std::mutex> guard(lock);
+    for (const auto &counter : counters) {
+        if (counter.first == name) return counter.second;
+    }
+    return 0;
+}
+
+void Statistics::report(std::ostream &os) const {
+    std::lock_guard<std::mutex> guard(lock);
+    for (const auto &counter : counters) {
+        os << "stats: " << counter.first << " " << counter.second << std::endl;
+    }
+}
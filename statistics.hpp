@@ -0,0 +1,26 @@
+#ifndef STATISTICS_HPP
+#define STATISTICS_HPP
+
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* Named counters of what the compiler removed or rewrote, reported by
+   --stats. Function bodies are generated concurrently, so counting is
+   thread safe. Counters are reported in the order they were first added. */
+class Statistics {
+public:
+    void add(const std::string &name, unsigned long count = 1);
+    unsigned long get(const std::string &name) const;
+
+    // One "stats: <name> <count>" line per counter
+    void report(std::ostream &os) const;
+
+private:
+    mutable std::mutex lock;
+    std::vector<std::pair<std::string, unsigned long>> counters;
+};
+
+#endif // STATISTICS_HPP
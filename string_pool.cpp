@@ -0,0 +1,75 @@
+#include "string_pool.hpp"
+#include "bytecode.hpp"
+#include <algorithm>
+
+StringPool::StringPool(const std::string &prefix) : prefix(prefix) {}
+
+void StringPool::add(const std::string &literal) {
+    if (index.count(literal)) {
+        ++duplicate_count;
+        return;
+    }
+    index[literal] = literals.size();
+    literals.push_back({literal, bytecode::constantBytes(literal)});
+}
+
+void StringPool::finish() {
+    // Sorted by their reversed bytes, a literal that ends another one comes
+    // right before a literal it ends, and the last of such a run holds them all
+    std::vector<std::string> reversed(literals.size());
+    std::vector<size_t> order(literals.size());
+    for (size_t i = 0; i < literals.size(); ++i) {
+        reversed[i].assign(literals[i].bytes.rbegin(), literals[i].bytes.rend());
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&reversed](size_t a, size_t b) {
+        return reversed[a] != reversed[b] ? reversed[a] < reversed[b] : a < b;
+    });
+    merged_count = 0;
+    for (size_t k = order.size(); k-- > 0;) {
+        size_t i = order[k];
+        literals[i].host = i;
+        if (k + 1 < order.size()) {
+            const std::string &next = reversed[order[k + 1]];
+            if (next.compare(0, reversed[i].size(), reversed[i]) == 0) {
+                literals[i].host = literals[order[k + 1]].host;
+                ++merged_count;
+            }
+        }
+    }
+
+    // Hosts are numbered in the order of their first literal
+    int globals = 0;
+    for (auto &literal : literals) {
+        if (literal.host != static_cast<size_t>(&literal - literals.data())) continue;
+        literal.entry.global = prefix + std::to_string(globals++);
+        literal.entry.global_length = static_cast<int>(literal.bytes.size()) + 1;
+    }
+    for (auto &literal : literals) {
+        const Literal &host = literals[literal.host];
+        literal.entry.global = host.entry.global;
+        literal.entry.global_length = host.entry.global_length;
+        literal.entry.length = static_cast<int>(literal.bytes.size());
+        literal.entry.offset = static_cast<int>(host.bytes.size() - literal.bytes.size());
+    }
+}
+
+const StringPool::Entry &StringPool::entry(const std::string &literal) const {
+    return literals[index.at(literal)].entry;
+}
+
+std::string StringPool::pointer(const std::string &literal) const {
+    const Entry &found = entry(literal);
+    std::string array = "[" + std::to_string(found.global_length) + " x i8]";
+    return "getelementptr inbounds (" + array + ", " + array + "* " + found.global + ", i32 0, i32 " +
+           std::to_string(found.offset) + ")";
+}
+
+void StringPool::emit(output::CodeBuffer &buffer) const {
+    for (size_t i = 0; i < literals.size(); ++i) {
+        const Literal &literal = literals[i];
+        if (literal.host != i) continue;
+        buffer.emit(literal.entry.global + " = private unnamed_addr constant [" +
+                    std::to_string(literal.entry.global_length) + " x i8] c\"" + literal.text + "\\00\"");
+    }
+}
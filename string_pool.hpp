@@ -0,0 +1,65 @@
+#ifndef STRING_POOL_HPP
+#define STRING_POOL_HPP
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "output.hpp"
+
+/* String literals of a program, interned by content.
+   Every distinct literal is stored once, and a literal that ends another
+   one is stored as a pointer into it: "world" lives inside "hello world".
+   Literals are in the source form LLVM reads between c"...", so lengths
+   and offsets are counted on the bytes the escapes stand for. The globals
+   are private unnamed_addr constants, named in the order their first
+   literal was added. */
+class StringPool {
+public:
+    // Where the bytes of a literal are
+    struct Entry {
+        std::string global;
+        // Length of the global's array, with its \00
+        int global_length = 0;
+        int offset = 0;
+        // Bytes of the literal, without a \00
+        int length = 0;
+    };
+
+    // Globals are named prefix0, prefix1, ...
+    explicit StringPool(const std::string &prefix);
+
+    void add(const std::string &literal);
+
+    // Lays out the globals; entries are only valid afterwards
+    void finish();
+
+    const Entry &entry(const std::string &literal) const;
+
+    // "getelementptr inbounds (...)" constant expression pointing at the literal
+    std::string pointer(const std::string &literal) const;
+
+    // One definition per global
+    void emit(output::CodeBuffer &buffer) const;
+
+    // Literals added again after their first time
+    size_t duplicates() const { return duplicate_count; }
+    // Distinct literals stored inside another global
+    size_t merged() const { return merged_count; }
+
+private:
+    struct Literal {
+        std::string text;
+        std::string bytes;
+        // Index of the literal whose global holds this one
+        size_t host = 0;
+        Entry entry;
+    };
+
+    std::string prefix;
+    std::vector<Literal> literals;
+    std::unordered_map<std::string, size_t> index;
+    size_t duplicate_count = 0;
+    size_t merged_count = 0;
+};
+
+#endif // STRING_POOL_HPP
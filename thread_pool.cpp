@@ -0,0 +1,106 @@
+#include "thread_pool.hpp"
+
+ThreadPool::ThreadPool(unsigned threads)
+    : queued(0), pending(0), next_queue(0), stopping(false) {
+    if (threads == 0) threads = 1;
+    for (unsigned i = 0; i < threads; ++i) {
+        queues.push_back(std::make_unique<TaskQueue>());
+    }
+    // The thread calling wait() acts as worker 0
+    for (unsigned i = 1; i < threads; ++i) {
+        this->threads.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(state_lock);
+        stopping = true;
+    }
+    work_available.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+unsigned ThreadPool::defaultThreads(unsigned requested) {
+    if (requested != 0) return requested;
+    unsigned hardware = std::thread::hardware_concurrency();
+    return hardware == 0 ? 1 : hardware;
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        // The counters are updated together with the push so a thief can never
+        // take a task before it has been counted
+        std::lock_guard<std::mutex> guard(state_lock);
+        TaskQueue& target = *queues[next_queue];
+        next_queue = (next_queue + 1) % queues.size();
+        {
+            std::lock_guard<std::mutex> queue_guard(target.lock);
+            target.tasks.push_back(std::move(task));
+        }
+        ++queued;
+        ++pending;
+    }
+    work_available.notify_one();
+}
+
+bool ThreadPool::runOne(size_t self) {
+    std::function<void()> task;
+
+    // Own tasks first, newest first; alone, oldest first, so a single
+    // thread runs them in submission order
+    {
+        std::lock_guard<std::mutex> guard(queues[self]->lock);
+        std::deque<std::function<void()>>& tasks = queues[self]->tasks;
+        if (!tasks.empty() && queues.size() == 1) {
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        } else if (!tasks.empty()) {
+            task = std::move(tasks.back());
+            tasks.pop_back();
+        }
+    }
+
+    // Otherwise steal the oldest task of another worker
+    for (size_t i = 1; !task && i < queues.size(); ++i) {
+        TaskQueue& victim = *queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+
+    if (!task) return false;
+
+    {
+        std::lock_guard<std::mutex> guard(state_lock);
+        --queued;
+    }
+    task();
+    {
+        std::lock_guard<std::mutex> guard(state_lock);
+        if (--pending == 0) all_done.notify_all();
+    }
+    return true;
+}
+
+void ThreadPool::workerLoop(size_t self) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(state_lock);
+            work_available.wait(guard, [this] { return stopping || queued > 0; });
+            if (stopping && queued == 0) return;
+        }
+        runOne(self);
+    }
+}
+
+void ThreadPool::wait() {
+    while (runOne(0)) {
+    }
+    std::unique_lock<std::mutex> guard(state_lock);
+    all_done.wait(guard, [this] { return pending == 0; });
+}
@@ -0,0 +1,64 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Work-stealing thread pool.
+   Every worker owns a task deque: it pops its own tasks from the back (from the
+   front when it is the only worker) and, when it runs dry, steals from the
+   front of the other workers' deques. Submitted tasks are spread round-robin
+   over the deques. wait() blocks until every submitted task has finished, and
+   the waiting thread runs tasks as well, so a pool created with a single
+   thread spawns nothing and runs the tasks serially in submission order.
+   Tasks must not throw. */
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queues a task for execution
+    void submit(std::function<void()> task);
+
+    // Runs queued tasks on the calling thread until all submitted tasks are done
+    void wait();
+
+    // Number of threads that execute tasks, including the waiting thread
+    unsigned size() const { return static_cast<unsigned>(queues.size()); }
+
+    // Resolves a user supplied job count (0 means "one per hardware thread")
+    static unsigned defaultThreads(unsigned requested);
+
+private:
+    struct TaskQueue {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    // queues[0] belongs to the thread calling wait(), queues[i] to threads[i - 1]
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+    std::vector<std::thread> threads;
+
+    std::mutex state_lock;
+    std::condition_variable work_available;
+    std::condition_variable all_done;
+    // Tasks sitting in some queue
+    size_t queued;
+    // Tasks submitted and not yet finished
+    size_t pending;
+    size_t next_queue;
+    bool stopping;
+
+    bool runOne(size_t self);
+    void workerLoop(size_t self);
+};
+
+#endif // THREAD_POOL_HPP
@@ -0,0 +1,292 @@
+#include "unroll.hpp"
+#include "ir_text.hpp"
+#include "statistics.hpp"
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace ir;
+
+namespace {
+    // Trip counts are only searched this far
+    const unsigned long max_trips = 1 << 16;
+
+    // "<op> i32 <a>, <b>"
+    bool binary(const std::string &rest, const std::string &op, std::string &a, std::string &b) {
+        std::string prefix = op + " i32 ";
+        if (!startsWith(rest, prefix)) return false;
+        size_t comma = rest.find(", ", prefix.size());
+        if (comma == std::string::npos) return false;
+        a = rest.substr(prefix.size(), comma - prefix.size());
+        b = rest.substr(comma + 2);
+        return true;
+    }
+
+    // "store i32 <value>, i32* <slot>"
+    bool stored(const std::string &line, std::string &value, std::string &slot) {
+        if (!startsWith(line, "store i32 ")) return false;
+        size_t comma = line.find(", i32* ");
+        if (comma == std::string::npos) return false;
+        value = line.substr(10, comma - 10);
+        slot = line.substr(comma + 7);
+        return true;
+    }
+
+    bool compare(const std::string &predicate, int32_t a, int32_t b) {
+        uint32_t ua = static_cast<uint32_t>(a), ub = static_cast<uint32_t>(b);
+        if (predicate == "eq") return a == b;
+        if (predicate == "ne") return a != b;
+        if (predicate == "slt") return a < b;
+        if (predicate == "sle") return a <= b;
+        if (predicate == "sgt") return a > b;
+        if (predicate == "sge") return a >= b;
+        if (predicate == "ult") return ua < ub;
+        if (predicate == "ule") return ua <= ub;
+        if (predicate == "ugt") return ua > ub;
+        return ua >= ub;
+    }
+
+    // How many times the body of a rotated loop runs once it is entered,
+    // 0 if that is not known or more than max_trips
+    unsigned long tripCount(const std::vector<std::string> &lines, const Loop &loop) {
+        // br i1 <condition>, label %<header>, label %<exit>, or the other way round
+        const std::string &branch = lines[loop.end];
+        std::vector<std::string> targets = labelOperands(branch);
+        if (!startsWith(branch, "br i1 ") || targets.size() != 2 || targets[0] == targets[1]) return 0;
+        bool again = targets[0] == loop.header;
+        std::string condition = branch.substr(6, branch.find(", ") - 6);
+
+        // Another branch back would start iterations the count misses
+        for (size_t i = loop.begin + 1; i < loop.end; ++i) {
+            for (const auto &target : labelOperands(lines[i])) {
+                if (target == loop.header) return 0;
+            }
+        }
+        size_t header_end = loop.begin + 1;
+        while (header_end < loop.end && !isTerminator(lines[header_end])) ++header_end;
+        size_t latch = loop.end;
+        while (!isLabel(lines[latch])) --latch;
+
+        std::unordered_map<std::string, size_t> definitions;
+        // slot -> the lines storing to it
+        std::unordered_map<std::string, std::vector<size_t>> stores;
+        for (size_t i = loop.begin + 1; i < loop.end; ++i) {
+            std::string name = definedName(lines[i]);
+            std::string value, slot;
+            if (!name.empty()) {
+                definitions[name] = i;
+            } else if (stored(lines[i], value, slot)) {
+                stores[slot].push_back(i);
+            }
+        }
+        auto rest = [&](const std::string &value) -> std::string {
+            auto definition = definitions.find(value);
+            if (definition == definitions.end()) return "";
+            return lines[definition->second].substr(value.size() + 3);
+        };
+
+        // icmp <predicate> i32 <a>, <b>, one of them a constant
+        std::string test = rest(condition);
+        if (!startsWith(test, "icmp ")) return 0;
+        size_t space = test.find(' ', 5);
+        std::string predicate = test.substr(5, space - 5);
+        std::string a, b;
+        if (!binary(test.substr(space), "", a, b)) return 0;
+        bool counter_first = isConstant(b);
+        std::string value = counter_first ? a : b;
+        std::string bound_text = counter_first ? b : a;
+        if (!isConstant(bound_text) || isConstant(value)) return 0;
+        int32_t bound = static_cast<int32_t>(std::stoll(bound_text));
+
+        // The counter: stored once, in a block every iteration runs, and
+        // tested after that store
+        auto everyIteration = [&](size_t line) { return line <= header_end || line >= latch; };
+        std::string counter, next;
+        if (startsWith(rest(value), "load i32, i32* ")) {
+            counter = rest(value).substr(15);
+            auto store = stores.find(counter);
+            if (store == stores.end() || store->second.size() != 1) return 0;
+            size_t at = store->second[0], load = definitions[value];
+            if (!everyIteration(at) || load < at || (at > header_end && load < latch)) return 0;
+            std::string slot;
+            stored(lines[at], next, slot);
+        } else {
+            for (const auto &store : stores) {
+                std::string stored_value, slot;
+                if (store.second.size() == 1 && stored(lines[store.second[0]], stored_value, slot) &&
+                    stored_value == value && everyIteration(store.second[0])) {
+                    counter = slot;
+                    next = value;
+                }
+            }
+            if (counter.empty()) return 0;
+        }
+
+        // next = [and i32 (]<load of the counter> + step[), 255]
+        bool masked = binary(rest(next), "and", a, b) && b == "255";
+        std::string sum = masked ? a : next;
+        long long step;
+        std::string operand;
+        if (binary(rest(sum), "add", a, b) && isConstant(b)) {
+            operand = a;
+            step = std::stoll(b);
+        } else if (binary(rest(sum), "add", a, b) && isConstant(a)) {
+            operand = b;
+            step = std::stoll(a);
+        } else if (binary(rest(sum), "sub", a, b) && isConstant(b)) {
+            operand = a;
+            step = -std::stoll(b);
+        } else {
+            return 0;
+        }
+        if (rest(operand) != "load i32, i32* " + counter) return 0;
+
+        // The value it enters with: the last store to it on the only way into
+        // the loop, followed back through blocks entered from one place only
+        std::unordered_map<std::string, int> references = labelReferences(lines);
+        std::unordered_map<std::string, size_t> referenced_from;
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (i >= loop.begin && i <= loop.end) continue;
+            for (const auto &target : labelOperands(lines[i])) referenced_from[target] = i;
+        }
+        if (references[loop.header] != 2 || !referenced_from.count(loop.header)) return 0;
+        size_t from = referenced_from[loop.header];
+        std::string initial;
+        // Bounded, blocks that only enter each other never run
+        for (size_t steps = 0; initial.empty(); ++steps) {
+            if (steps > lines.size()) return 0;
+            std::string stored_value, slot;
+            if (stored(lines[from], stored_value, slot) && slot == counter) {
+                if (!isConstant(stored_value)) return 0;
+                initial = stored_value;
+            } else if (isLabel(lines[from])) {
+                std::string label = lines[from].substr(0, lines[from].size() - 1);
+                if (references[label] != 1 || !referenced_from.count(label)) return 0;
+                from = referenced_from[label];
+            } else if (startsWith(lines[from], "define ")) {
+                return 0;
+            } else {
+                --from;
+            }
+        }
+
+        int32_t counted = static_cast<int32_t>(std::stoll(initial));
+        for (unsigned long trips = 1; trips <= max_trips; ++trips) {
+            counted = static_cast<int32_t>(static_cast<uint32_t>(counted) + static_cast<uint32_t>(step));
+            if (masked) counted &= 255;
+            bool holds = counter_first ? compare(predicate, counted, bound) : compare(predicate, bound, counted);
+            if (holds != again) return trips;
+        }
+        return 0;
+    }
+
+    // The lines of the loop with every name it defines given the suffix
+    std::vector<std::string> copyOf(const std::vector<std::string> &lines, const Loop &loop,
+                                    const std::unordered_set<std::string> &defined, const std::string &suffix) {
+        std::vector<std::string> copy;
+        for (size_t i = loop.begin; i <= loop.end; ++i) {
+            const std::string &line = lines[i];
+            if (isLabel(line)) {
+                copy.push_back(line.substr(0, line.size() - 1) + suffix + ":");
+                continue;
+            }
+            std::string renamed;
+            size_t copied = 0;
+            forEachName(line, [&](size_t begin, size_t end) {
+                if (!defined.count(line.substr(begin + 1, end - begin - 1))) return;
+                renamed.append(line, copied, end - copied);
+                renamed += suffix;
+                copied = end;
+            });
+            renamed.append(line, copied, std::string::npos);
+            copy.push_back(renamed);
+        }
+        return copy;
+    }
+}
+
+std::string unrollLoops(const std::string &function, unsigned budget, Statistics *statistics) {
+    // Phis name the blocks they are entered from, which the copies would change
+    if (budget == 0 || function.find(" = phi ") != std::string::npos) return function;
+
+    std::vector<std::string> lines = splitLines(function);
+    unsigned long completely = 0, partially = 0, numbered = 0;
+
+    std::unordered_set<std::string> done;
+    for (;;) {
+        // Inner loops first, an unrolled one may let the enclosing loop fit
+        std::vector<Loop> loops = findLoops(lines);
+        const Loop *next = nullptr;
+        for (const auto &loop : loops) {
+            if (done.count(loop.header)) continue;
+            if (!next || loop.end - loop.begin < next->end - next->begin) next = &loop;
+        }
+        if (!next) break;
+        Loop loop = *next;
+        done.insert(loop.header);
+        if (!singleEntry(lines, loop)) continue;
+
+        // Names without the %; values used after the loop would need the last copy's
+        std::unordered_set<std::string> defined;
+        unsigned long size = 0;
+        for (size_t i = loop.begin; i <= loop.end; ++i) {
+            if (isLabel(lines[i])) {
+                defined.insert(lines[i].substr(0, lines[i].size() - 1));
+                continue;
+            }
+            ++size;
+            std::string name = definedName(lines[i]);
+            if (!name.empty()) defined.insert(name.substr(1));
+        }
+        bool escapes = false;
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (i >= loop.begin && i <= loop.end) continue;
+            forEachName(lines[i], [&](size_t begin, size_t end) {
+                const std::string name = lines[i].substr(begin + 1, end - begin - 1);
+                if (defined.count(name) && name != loop.header) escapes = true;
+            });
+        }
+        if (escapes) continue;
+
+        unsigned long trips = tripCount(lines, loop);
+        if (trips == 0) continue;
+        unsigned long copies = trips;
+        while (copies > 1 && (copies * size > budget || trips % copies != 0)) --copies;
+        bool complete = copies == trips;
+        if (!complete && copies < 2) continue;
+
+        std::vector<std::string> targets = labelOperands(lines[loop.end]);
+        std::string exit = targets[0] == loop.header ? targets[1] : targets[0];
+        std::vector<std::string> result(lines.begin(), lines.begin() + loop.begin);
+        // Numbered across the function: the copies of an unrolled inner loop
+        // are renamed again when the enclosing loop is unrolled
+        std::vector<std::string> suffixes = {""};
+        while (suffixes.size() < copies) suffixes.push_back(".u" + std::to_string(++numbered));
+        for (unsigned long k = 0; k < copies; ++k) {
+            const std::string &suffix = suffixes[k];
+            std::vector<std::string> copy = copyOf(lines, loop, defined, suffix);
+            // Only the last copy of a round may leave through the test
+            if (k + 1 < copies) {
+                copy.back() = "br label %" + loop.header + suffixes[k + 1];
+            } else if (complete) {
+                copy.back() = "br label %" + exit;
+            } else {
+                copy.back() = retarget(copy.back(), loop.header + suffix, loop.header);
+            }
+            result.insert(result.end(), copy.begin(), copy.end());
+            for (const auto &line : copy) {
+                if (isLabel(line)) done.insert(line.substr(0, line.size() - 1));
+            }
+        }
+        result.insert(result.end(), lines.begin() + loop.end + 1, lines.end());
+        lines.swap(result);
+        ++(complete ? completely : partially);
+    }
+
+    if (statistics) {
+        statistics->add("loops unrolled completely", completely);
+        statistics->add("loops unrolled partially", partially);
+    }
+    return joinLines(lines);
+}
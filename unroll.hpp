@@ -0,0 +1,23 @@
+#ifndef UNROLL_HPP
+#define UNROLL_HPP
+
+#include <string>
+
+class Statistics;
+
+/* Unrolling of the loops in the IR text of one function (see ir_text.hpp)
+   whose trip count is known when the function is compiled. The loop must
+   be rotated, tested at its latch by a comparison of a counter with a
+   constant, and the counter a slot stored to once per iteration, with its
+   own value plus a constant, in the header or the latch block. Its value
+   on entry is the constant the blocks leading to the loop store to it.
+
+   The copies of the body follow each other and the tests between them,
+   known to hold, become plain branches. A loop whose copies fit within
+   budget instructions is unrolled completely; otherwise by the largest
+   factor of its trip count that fits, so only the last copy tests.
+   Branches out of the loop (break) still leave it from every copy, and
+   branches to the latch (continue) go to the latch of their own copy. */
+std::string unrollLoops(const std::string &function, unsigned budget, Statistics *statistics);
+
+#endif // UNROLL_HPP
@@ -0,0 +1,102 @@
+#include "value_numbering.hpp"
+#include "ir_text.hpp"
+#include "statistics.hpp"
+#include <unordered_map>
+#include <vector>
+
+using namespace ir;
+
+namespace {
+    bool isPure(const std::string &instruction) {
+        static const char *const pure[] = {"add ", "sub ", "mul ", "sdiv ", "udiv ", "and ", "or ", "xor ",
+                                           "icmp ", "zext ", "trunc "};
+        for (const char *prefix : pure) {
+            if (startsWith(instruction, prefix)) return true;
+        }
+        return false;
+    }
+
+    // The instruction with the operands of a commutative operation sorted
+    std::string canonical(const std::string &instruction) {
+        static const char *const commutative[] = {"add ", "mul ", "and ", "or ", "xor ", "icmp eq ", "icmp ne "};
+        bool swappable = false;
+        for (const char *prefix : commutative) {
+            if (startsWith(instruction, prefix)) swappable = true;
+        }
+        size_t comma = instruction.find(", ");
+        if (!swappable || comma == std::string::npos) return instruction;
+        size_t space = instruction.rfind(' ', comma);
+        std::string left = instruction.substr(space + 1, comma - space - 1);
+        std::string right = instruction.substr(comma + 2);
+        if (left <= right) return instruction;
+        return instruction.substr(0, space + 1) + right + ", " + left;
+    }
+}
+
+std::string numberValues(const std::string &function, Statistics *statistics) {
+    std::vector<std::string> lines = splitLines(function);
+    std::unordered_map<std::string, int> references = labelReferences(lines);
+    unsigned long loads = 0, values = 0;
+
+    // Expression -> the value that holds it
+    using Table = std::unordered_map<std::string, std::string>;
+    Table available;
+    // What the only predecessor of a label knew at its end
+    std::unordered_map<std::string, Table> entry;
+    Substitution substitution;
+    std::vector<std::string> kept;
+    for (const auto &original : lines) {
+        std::string line = substitution.apply(original);
+        if (isLabel(line)) {
+            auto known = entry.find(line.substr(0, line.size() - 1));
+            if (known != entry.end()) {
+                available.swap(known->second);
+                entry.erase(known);
+            } else {
+                available.clear();
+            }
+        } else if (startsWith(line, "define ")) {
+            available.clear();
+        }
+
+        std::string name = definedName(line);
+        if (!name.empty()) {
+            std::string rest = line.substr(name.size() + 3);
+            bool load = startsWith(rest, "load ");
+            if (load || isPure(rest)) {
+                std::string key = load ? rest : canonical(rest);
+                auto earlier = available.find(key);
+                if (earlier != available.end()) {
+                    substitution.add(name, earlier->second);
+                    ++(load ? loads : values);
+                    continue;
+                }
+                available[key] = name;
+            }
+        } else if (startsWith(line, "store ")) {
+            // store <type> <value>, <type>* <slot> makes the value that of "load <type>, <type>* <slot>"
+            size_t type_end = line.find(' ', 6);
+            std::string type = line.substr(6, type_end - 6);
+            size_t comma = line.find(", ", type_end);
+            std::string slot = line.substr(line.rfind("* ") + 2);
+            available["load " + type + ", " + type + "* " + slot] = line.substr(type_end + 1, comma - type_end - 1);
+        } else if (isTerminator(line)) {
+            for (size_t at = line.find("label %"); at != std::string::npos; at = line.find("label %", at + 7)) {
+                size_t end = at + 7;
+                while (end < line.size() && isNameChar(line[end])) ++end;
+                std::string target = line.substr(at + 7, end - at - 7);
+                if (references[target] == 1) entry[target] = available;
+            }
+        }
+        kept.push_back(line);
+    }
+    for (auto &line : kept) {
+        line = substitution.apply(line);
+    }
+
+    if (statistics) {
+        statistics->add("value numbering reused loads", loads);
+        statistics->add("value numbering reused values", values);
+    }
+    return joinLines(kept);
+}
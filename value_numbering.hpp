@@ -0,0 +1,20 @@
+#ifndef VALUE_NUMBERING_HPP
+#define VALUE_NUMBERING_HPP
+
+#include <string>
+
+class Statistics;
+
+/* Local value numbering over the IR text of one function (see ir_text.hpp).
+   An instruction computing what an earlier one in the block already has is
+   replaced by the earlier value:
+   - a load of a slot, up to the next store to it, after which the stored
+     value is the slot's value
+   - arithmetic, comparisons and casts with the same operands, taken in a
+     fixed order for the commutative ones
+   Slots are allocas whose address never leaves the function, so calls do
+   not end the reuse of their loads. A block with a single predecessor
+   starts with what was known at the end of that predecessor. */
+std::string numberValues(const std::string &function, Statistics *statistics);
+
+#endif // VALUE_NUMBERING_HPP